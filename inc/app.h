@@ -3,6 +3,54 @@
 
 #include "image.h"
 
+/// @brief what a run would produce, gathered from the labels and the image
+/// headers only
+struct crop_summary {
+  // power of two size buckets, from "< 16" to ">= 4096"
+  static const int buckets = 10;
+
+  unsigned long images = 0;     // images with at least one crop
+  unsigned long objects = 0;    // objects read from the labels
+  unsigned long kept = 0;       // objects that passed --clss and --cnfd
+  unsigned long crops = 0;      // crops that passed -s and --lock
+  unsigned long long bytes = 0; // uncompressed size of the crops
+  unsigned long object_sizes[buckets] = {}; // smaller side of the kept objects
+  unsigned long crop_sizes[buckets] = {};   // larger side of the crops
+  std::map<int, unsigned long> classes;     // number of crops per class
+
+  static int bucket(const int size) {
+    int b = 0;
+    while (b < buckets - 1 && size >= (16 << b))
+      b++;
+    return b;
+  }
+
+  void merge(const crop_summary &other) {
+    images += other.images;
+    objects += other.objects;
+    kept += other.kept;
+    crops += other.crops;
+    bytes += other.bytes;
+    for (int b = 0; b < buckets; b++) {
+      object_sizes[b] += other.object_sizes[b];
+      crop_sizes[b] += other.crop_sizes[b];
+    }
+    for (const auto &c : other.classes)
+      classes[c.first] += c.second;
+  }
+};
+
+/// @brief what a run did, once App::run() returned
+struct RunReport {
+  unsigned images = 0;            // images found in the input folder
+  unsigned processed = 0;         // images that went through the stages
+  unsigned unprocessed = 0;       // images left out once --trgt was reached
+  ssize_t created = 0;            // generated images (would be, for a dry run)
+  std::vector<unsigned> order;    // indices of the images, as they completed
+  std::vector<unsigned> prepared; // images prepared by each read worker
+  crop_summary summary;           // only filled by dry runs
+};
+
 class App {
 private:
   // input folder containing the files to be processed
@@ -13,12 +61,32 @@ private:
   // path to the config file folder if different from the input folder
   std::string _path_to_config_folder;
   bool _config_folder_is_input_folder = false;
+  bool _config_folder_is_set = false;
+
+  // path to a single label index file, instead of the config folder
+  std::string _path_to_label_index;
+  // path to the compiled cache of the config folder
+  std::string _path_to_label_cache;
+  // path to a COCO annotation file, instead of the config folder
+  std::string _path_to_coco_file;
+  // class names of the Pascal VOC files of the config folder, if any
+  std::string _path_to_voc_names;
 
   // image file extention
   std::string _image_ext = ".png";
 
-  // max number of threads to use for processing
+  // number of threads shared by the stages
   unsigned _max_threads = 8;
+  // workers of the read, decode, crop, encode and write stages, out of
+  // _max_threads unless set
+  int _read_threads = EOF;
+  int _decode_threads = EOF;
+  int _crop_threads = EOF;
+  int _encode_threads = EOF;
+  int _write_threads = EOF;
+
+  // bytes of the images decoded at once, 0 for no limit
+  size_t _mem_budget = 0;
 
   // image shape to crop to
   ImageShape _image_shape = ImageShape::undefined;
@@ -30,6 +98,10 @@ private:
   // minimum confidence threshold for detection
   double _min_confidence = 0.5;
 
+  // maximum IoU of two cropped objects of the same class
+  double _nms_iou = EOF;
+  bool _nms_iou_is_set = false;
+
   // class id to use for detection
   int _class_id = EOF;
   bool _class_id_is_set = false;
@@ -46,6 +118,9 @@ private:
   // locking cropping if target image is out
   bool _lock = false;
 
+  // only report what would be cropped
+  bool _dry_run = false;
+
   // minimum size of the object to be processed
   int _min_object_size = EOF;
   // maximum size of the object to be processed
@@ -55,6 +130,9 @@ private:
   // target height of the generated cropped image
   int _target_height = EOF;
 
+  // what the last run did
+  RunReport _report;
+
 public:
   /**
    * @brief Construct a new App object
@@ -86,4 +164,11 @@ public:
    *
    */
   int run();
+
+  /**
+   * @brief what the last run did
+   *
+   * @return const RunReport& - the report, empty before run()
+   */
+  const RunReport &report() const;
 };
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "label.h"
+
+/**
+ * @brief the objects of a COCO annotation file, read in a single streaming
+ * pass (no document tree is ever built)
+ * @note the absolute "bbox" of each annotation is normalized with the width
+ * and height of its image, its "category_id" is used as the class and a
+ * missing "score" defaults to 1 ; the annotations go straight to the table
+ * once their image is known, only the ones read before it are held by image
+ * id until then
+ *
+ */
+class CocoIndex : public LabelTable {
+private:
+  size_t _orphans = 0; // annotations of an unknown image
+
+public:
+  /**
+   * @brief read the annotation file
+   * @note panics if the file cannot be read or is not valid JSON
+   *
+   * @param path path to the annotation file
+   */
+  explicit CocoIndex(const std::string &path);
+
+  /// @brief number of annotations whose image is unknown, or has no size
+  size_t orphans() const;
+};
@@ -2,19 +2,202 @@
 
 #include "lib.h"
 
+/// @brief horizontal extent [first, second) of a shape on each of its rows
+typedef std::vector<std::pair<int, int>> Spans;
+
+/**
+ * @brief shared cache of the ellipse masks, keyed by their dimensions
+ * @note the masks do not depend on the position of the crop, as long as the
+ * coordinates stay well below 2^24 (exact float arithmetic)
+ *
+ */
+class MaskCache {
+private:
+  // maximum number of cached masks, to bound the memory used
+  static const size_t capacity = 1 << 12;
+
+  std::mutex _mutex;
+  std::map<std::pair<int, int>, std::shared_ptr<const Spans>> _ellipses;
+  std::atomic<unsigned long> _hits, _misses;
+
+  MaskCache();
+
+public:
+  /**
+   * @brief the cache shared by all threads
+   *
+   * @return MaskCache& - the cache
+   */
+  static MaskCache &instance();
+
+  /**
+   * @brief get the row spans of the ellipse inscribed in a rectangle
+   *
+   * @param width width of the rectangle
+   * @param height height of the rectangle
+   * @return std::shared_ptr<const Spans> - one span per row (empty if first
+   * >= second)
+   */
+  std::shared_ptr<const Spans> ellipse(int width, int height);
+
+  unsigned long hits() const;
+  unsigned long misses() const;
+};
+
+/**
+ * @brief per-thread pool of reusable, 64-byte aligned pixel buffers
+ * @note the buffers come from posix_memalign and can be released with free()
+ *
+ */
+class BufferPool {
+private:
+  // alignment of the buffers
+  static const size_t alignment = 64;
+  // maximum number of idle buffers kept by each thread
+  static const size_t capacity = 4;
+
+  // idle buffers, with their capacity
+  std::vector<std::pair<size_t, unsigned char *>> _idle;
+
+public:
+  ~BufferPool();
+
+  /**
+   * @brief the pool of the calling thread
+   *
+   * @return BufferPool& - the pool
+   */
+  static BufferPool &local();
+
+  /**
+   * @brief get an uninitialized buffer of at least `size` bytes
+   *
+   * @param size requested size
+   * @param capacity actual size of the buffer
+   * @return unsigned char* - the buffer
+   */
+  unsigned char *acquire(size_t size, size_t &capacity);
+
+  /**
+   * @brief give a buffer back to the pool (or free it if the pool is full)
+   *
+   * @param data the buffer
+   * @param capacity actual size of the buffer
+   */
+  void release(unsigned char *data, size_t capacity);
+};
+
+class Image;
+
+/**
+ * @brief non-owning view of a rectangle of pixels, rows being `stride` bytes
+ * apart
+ * @note the viewed image must outlive the view
+ *
+ */
+class ImageView {
+private:
+  const unsigned char *_data;
+  int _width, _height, _channels;
+  size_t _stride;
+
+public:
+  ImageView(const unsigned char *data, int width, int height, int channels,
+            size_t stride);
+  ImageView(const Image &image);
+
+  int width() const;
+  int height() const;
+  int channels() const;
+  size_t stride() const;
+  const unsigned char *data() const;
+
+  /**
+   * @brief encode the view, without copying it when the format allows strides
+   *
+   * @param path path to the image file (the extension selects the format)
+   * @return true - if the image was written
+   */
+  bool write(const std::string &path) const;
+
+  /**
+   * @brief encode the view in memory, the bytes of write() without the file
+   *
+   * @param type format of the encoded image
+   * @param bytes the encoded image (replaced)
+   * @return true - if the image was encoded
+   */
+  bool encode(const ImageType type, std::vector<unsigned char> &bytes) const;
+
+  /**
+   * @brief view a rectangle of the image without copying it
+   * @note the rectangle must be inside of the image
+   *
+   * @param x top-left x coordinate
+   * @param y top-left y coordinate
+   * @param width width of the rectangle
+   * @param height height of the rectangle
+   * @return ImageView - the view
+   */
+  ImageView view(int x, int y, int width, int height) const;
+};
+
 class Image {
 private:
   int _width, _height, _channels;
   size_t _size;
   unsigned char *_data = nullptr;
+  // capacity of the buffer if it comes from a BufferPool, 0 otherwise
+  size_t _capacity = 0;
+
+  /**
+   * @brief construct an image with an uninitialized buffer from the pool of
+   * the calling thread
+   *
+   */
+  Image(int width, int height, int channels, BufferPool &pool);
+
+  /**
+   * @brief give the image new dimensions, reusing its buffer if it is large
+   * enough (the pixels are left uninitialized)
+   *
+   */
+  void reshape(int width, int height, int channels);
+
+  /**
+   * @brief copy a shape of the image at the center of `cropped`, in a single
+   * pass over the rows
+   *
+   * @param cropped the destination image
+   * @param x top-left x coordinate
+   * @param y top-left y coordinate
+   * @param width width of the shape
+   * @param height height of the shape
+   * @param bg background image, cropped at its center around the shape
+   * @param spans row spans of the shape (nullptr for the whole rectangle)
+   */
+  void compose(Image &cropped, int x, int y, int width, int height,
+               const Image *bg, const Spans *spans) const;
+
+  /**
+   * @brief compose() specialized for C channels (0 for any number)
+   *
+   */
+  template <int C>
+  void compose_n(Image &cropped, int x, int y, int width, int height,
+                 const Image *bg, const Spans *spans) const;
 
 public:
   Image();
   Image(const std::string &path, int channels_force = 0);
   Image(int width, int height, int channels = 3);
   Image(const Image &other);
+  Image(Image &&other) noexcept;
   ~Image();
 
+  Image &operator=(const Image &other);
+  Image &operator=(Image &&other) noexcept;
+
   const int &width() const;
   int &width();
   void width(const int &width);
@@ -35,36 +218,86 @@ public:
   unsigned char *data();
   void data(const unsigned char *data);
 
+  /**
+   * @brief read the dimensions of an image file without decoding it
+   *
+   * @param path path to the image file
+   * @param width width of the image
+   * @param height height of the image
+   * @param channels number of channels stored in the file
+   * @return true - if the header could be read
+   */
+  static bool probe(const std::string &path, int &width, int &height,
+                    int &channels);
+  /// @brief probe() for an image file already in memory
+  static bool probe(const unsigned char *bytes, const size_t size, int &width,
+                    int &height, int &channels);
+
   bool read(const std::string &path, int channels_force = 0);
+  /// @brief read() for an image file already in memory
+  bool decode(const unsigned char *bytes, const size_t size,
+              int channels_force = 0);
   bool write(const std::string &path) const;
 
   /**
-   * @brief crop the image according to the rectangle and return a new image
+   * @brief view a rectangle of the image without copying it
+   * @note the rectangle must be inside of the image
+   *
+   * @param x top-left x coordinate
+   * @param y top-left y coordinate
+   * @param width width of the rectangle
+   * @param height height of the rectangle
+   * @return ImageView - the view
+   */
+  ImageView view(int x, int y, int width, int height) const;
+
+  /**
+   * @brief crop the image according to the rectangle into `cropped`, reusing
+   * its buffer when possible
    *
+   * @param cropped the cropped image
    * @param x top-left x coordinate
    * @param y top-left y coordinate
    * @param width width of the cropped image
    * @param height height of the cropped image
-   * @param bg background image to fill the cropped area with
-   * @param bw background image width
-   * @param bh background image height
-   * @return Image* - the cropped image
+   * @param bg background image, cropped at its center to fill the new image
+   * @param bw new image width
+   * @param bh new image height
+   */
+  void crop_rect(Image &cropped, int x, int y, int width, int height,
+                 const Image *bg = nullptr, int bw = EOF, int bh = EOF) const;
+
+  /**
+   * @brief crop the image according to the rectangle and return a new image
+   *
+   * @return Image - the cropped image
    */
-  Image *crop_rect(int x, int y, int width, int height, Image *bg = nullptr,
-                   int bw = EOF, int bh = EOF) const;
+  Image crop_rect(int x, int y, int width, int height,
+                  const Image *bg = nullptr, int bw = EOF, int bh = EOF) const;
 
   /**
-   * @brief crop the image accorging to the ellipse and return a new image
+   * @brief crop the image according to the ellipse into `cropped`, reusing
+   * its buffer when possible
    *
+   * @param cropped the cropped image
    * @param x top-left x coordinate
    * @param y top-left y coordinate
    * @param width width of the cropped image
    * @param height height of the cropped image
-   * @param bg background image to fill the cropped area with
-   * @param bw background image width
-   * @param bh background image height
-   * @return Image* - the cropped image
+   * @param bg background image, cropped at its center to fill the new image
+   * @param bw new image width
+   * @param bh new image height
+   */
+  void crop_ellipse(Image &cropped, int x, int y, int width, int height,
+                    const Image *bg = nullptr, int bw = EOF,
+                    int bh = EOF) const;
+
+  /**
+   * @brief crop the image according to the ellipse and return a new image
+   *
+   * @return Image - the cropped image
    */
-  Image *crop_ellipse(int x, int y, int width, int height, Image *bg = nullptr,
-                      int bw = EOF, int bh = EOF) const;
+  Image crop_ellipse(int x, int y, int width, int height,
+                     const Image *bg = nullptr, int bw = EOF,
+                     int bh = EOF) const;
 };
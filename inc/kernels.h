@@ -0,0 +1,65 @@
+#pragma once
+
+#include "lib.h"
+
+/// @brief the image codecs, compiled once for each supported ISA level
+struct Kernels {
+  // name of the ISA level the kernels were compiled for
+  const char *isa;
+
+  // decode an image file, see stbi_load
+  unsigned char *(*load)(const char *path, int *x, int *y, int *comp,
+                         int req_comp);
+  // read the header of an image file, see stbi_info
+  int (*info)(const char *path, int *x, int *y, int *comp);
+  // release a decoded image, see stbi_image_free
+  void (*free)(void *data);
+
+  // encode an image file, see stbi_write_png, stbi_write_jpg, stbi_write_bmp
+  int (*write_png)(const char *path, int w, int h, int comp, const void *data,
+                   int stride);
+  int (*write_jpg)(const char *path, int w, int h, int comp, const void *data,
+                   int quality);
+  int (*write_bmp)(const char *path, int w, int h, int comp, const void *data);
+
+  // decode an image held in memory, see stbi_load_from_memory
+  unsigned char *(*load_memory)(const unsigned char *buffer, int len, int *x,
+                                int *y, int *comp, int req_comp);
+  // read the header of an image held in memory, see stbi_info_from_memory
+  int (*info_memory)(const unsigned char *buffer, int len, int *x, int *y,
+                     int *comp);
+
+  // encode an image through a callback, see stbi_write_png_to_func,
+  // stbi_write_jpg_to_func, stbi_write_bmp_to_func
+  int (*encode_png)(void (*func)(void *context, void *data, int size),
+                    void *context, int w, int h, int comp, const void *data,
+                    int stride);
+  int (*encode_jpg)(void (*func)(void *context, void *data, int size),
+                    void *context, int w, int h, int comp, const void *data,
+                    int quality);
+  int (*encode_bmp)(void (*func)(void *context, void *data, int size),
+                    void *context, int w, int h, int comp, const void *data);
+};
+
+/**
+ * @brief the kernels selected for the running CPU
+ * @note the selection is done once, on the first call
+ *
+ * @return const Kernels& - the selected kernels
+ */
+const Kernels &kernels();
+
+/**
+ * @brief all the kernels this binary was built with, from the most generic
+ * to the most specific one
+ *
+ * @return const std::vector<const Kernels *>& - the built kernels
+ */
+const std::vector<const Kernels *> &kernels_built();
+
+/**
+ * @brief describe the CPU features and the selected kernels
+ *
+ * @return std::string - a human readable description
+ */
+std::string kernels_info();
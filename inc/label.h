@@ -0,0 +1,237 @@
+#pragma once
+
+#include "lib.h"
+
+/// @brief one object from a config file
+struct Box {
+  int cls;      // the class id of the object
+  double cx;    // the center x coordinate, in the range [0, 1]
+  double cy;    // the center y coordinate, in the range [0, 1]
+  double w;     // the width, in the range [0, 1]
+  double h;     // the height, in the range [0, 1]
+  double score; // the confidence of the object
+};
+
+enum struct LabelStatus { ok, unreadable, malformed };
+
+/**
+ * @brief greedy non maximum suppression, per class: of the objects of a class
+ * overlapping by more than `iou`, only the best scoring one is kept
+ * @note the intersection over union does not depend on the image size, so it
+ * is computed on the normalized coordinates ; the kept objects stay in order
+ *
+ * @param boxes the objects of an image, filtered in place
+ * @param iou maximum intersection over union of two kept objects
+ * @return size_t - number of suppressed objects
+ */
+size_t suppress_overlaps(std::vector<Box> &boxes, const double iou);
+
+/**
+ * @brief read-only memory mapping of a whole file
+ *
+ */
+class MappedFile {
+private:
+  const char *_data = nullptr;
+  size_t _size = 0;
+  bool _open = false;
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  bool is_open() const;
+  const char *data() const;
+  size_t size() const;
+};
+
+/**
+ * @brief parse one "class x y width height confidence" line, the same way
+ * sscanf(line, "%d %lf %lf %lf %lf %lf", ...) would, without allocating
+ * @note fields that could not be converted are left untouched
+ *
+ * @param line first character of the line
+ * @param end one past the last character of the line
+ * @param box the parsed object
+ * @return int - number of converted fields, or EOF if the line is blank
+ */
+int parse_box(const char *line, const char *end, Box &box);
+
+/**
+ * @brief parse a YOLO config file, stopping at the first blank line (like
+ * the sscanf loop did)
+ *
+ * @param path path to the config file
+ * @param boxes the parsed objects are appended here
+ * @return LabelStatus - ok, unreadable (could not open) or malformed (blank
+ * line)
+ */
+LabelStatus read_labels(const std::string &path, std::vector<Box> &boxes);
+
+/**
+ * @brief where the objects of each image are read from
+ *
+ */
+class LabelSource {
+public:
+  virtual ~LabelSource() {}
+
+  /**
+   * @brief read the objects of an image
+   *
+   * @param stem name of the image, without its extension
+   * @param boxes the objects are appended here
+   * @return LabelStatus - same as read_labels
+   */
+  virtual LabelStatus read(const std::string &stem,
+                           std::vector<Box> &boxes) const = 0;
+  /**
+   * @brief where the objects of an image are looked for, for the logs
+   *
+   * @param stem name of the image, without its extension
+   * @return std::string - the location
+   */
+  virtual std::string location(const std::string &stem) const = 0;
+  /**
+   * @brief what the objects depend on, besides the files of the images, so
+   * that a cache can tell when it is stale
+   *
+   * @return std::string - the signature of the source
+   */
+  virtual std::string signature() const;
+  /// @brief number of objects read so far but left out of the labels
+  virtual unsigned long dropped() const;
+};
+
+/**
+ * @brief one YOLO config file per image, in a folder
+ *
+ */
+class LabelFolder : public LabelSource {
+private:
+  std::string _path; // path to the folder, with a trailing '/'
+
+public:
+  explicit LabelFolder(const std::string &path);
+
+  LabelStatus read(const std::string &stem,
+                   std::vector<Box> &boxes) const override;
+  std::string location(const std::string &stem) const override;
+};
+
+/**
+ * @brief name of an image, without its folder and its extension
+ *
+ * @param begin first character of the name
+ * @param end one past the last character of the name
+ * @return std::string - the stem of the image
+ */
+std::string image_stem(const char *begin, const char *end);
+
+/**
+ * @brief the objects of a whole dataset, loaded once from a single file and
+ * indexed by image stem so that a lookup does not touch the file system
+ * @note images without any object are not in the table
+ *
+ */
+class LabelTable : public LabelSource {
+protected:
+  std::string _path; // path to the loaded file
+  std::unordered_map<std::string, std::vector<Box>> _boxes;
+  size_t _rows = 0; // number of objects in the table
+
+  explicit LabelTable(const std::string &path);
+
+  /// @brief append an object to an image
+  void add(const std::string &stem, const Box &box);
+  /// @brief append the objects of an image, without copying them if it has
+  /// none yet
+  void add(const std::string &stem, std::vector<Box> &&boxes);
+
+public:
+  LabelStatus read(const std::string &stem,
+                   std::vector<Box> &boxes) const override;
+  std::string location(const std::string &stem) const override;
+
+  /// @brief number of images with at least one object
+  size_t images() const;
+  /// @brief number of objects
+  size_t rows() const;
+};
+
+/**
+ * @brief all the objects of the dataset in a single TSV or CSV file
+ * @note rows are "image class x y width height [confidence]", separated by
+ * tabs or commas ; the image may carry a folder and an extension, a missing
+ * confidence defaults to 1 ; blank rows and rows starting with '#' are
+ * skipped, and so is a header as the first of the other rows
+ *
+ */
+class LabelIndex : public LabelTable {
+public:
+  /**
+   * @brief load the index file
+   * @note panics if the file cannot be read or has a malformed row
+   *
+   * @param path path to the index file
+   */
+  explicit LabelIndex(const std::string &path);
+};
+
+// one image of a label cache, defined with the file layout
+struct CacheEntry;
+
+/**
+ * @brief per-image label files compiled into a binary cache, mapped in memory
+ * on the next runs
+ * @note the cache holds a struct of arrays of the fields of all the objects
+ * and, per image, its range of objects, its parse status and the size and
+ * modification time of its label file ; it is compiled again as soon as one
+ * of them, or the signature of the source, changes (the file is only meant
+ * for the machine that wrote it)
+ *
+ */
+class LabelCache : public LabelSource {
+private:
+  const LabelSource &_files; // the label files behind the cache
+  std::unique_ptr<MappedFile> _file;
+
+  const CacheEntry *_entries = nullptr;
+  const char *_names = nullptr;
+  const int32_t *_cls = nullptr;
+  const double *_cx = nullptr, *_cy = nullptr, *_w = nullptr, *_h = nullptr,
+               *_score = nullptr;
+  std::unordered_map<std::string, size_t> _index; // entry of each image
+
+  bool _compiled = false; // the cache was (re)compiled by this run
+
+  mutable std::atomic<unsigned long> _dropped; // by the cached images
+  unsigned long _baseline = 0; // dropped by the files before the cache was up
+
+  bool map(const std::string &path, const std::string &signature);
+  void compile(const std::string &path, const std::string &signature,
+               const std::vector<std::string> &stems) const;
+
+public:
+  /**
+   * @brief map the cache, compiling it first if it is missing or stale
+   * @note panics if the cache cannot be written
+   *
+   * @param path path to the cache file
+   * @param files the per-image label files, must outlive the cache
+   * @param stems names of the images of the run, without their extension
+   */
+  LabelCache(const std::string &path, const LabelSource &files,
+             const std::vector<std::string> &stems);
+
+  LabelStatus read(const std::string &stem,
+                   std::vector<Box> &boxes) const override;
+  std::string location(const std::string &stem) const override;
+  unsigned long dropped() const override;
+
+  /// @brief whether the cache had to be (re)compiled
+  bool compiled() const;
+};
@@ -1,26 +1,41 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <csignal>
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <future>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -62,6 +77,17 @@
 #define OPT_CNFD 2000 + 2 // confidence
 #define OPT_TRGT 2000 + 3 // target
 #define OPT_LOCK 2000 + 4 // lock
+#define OPT_DRYR 2000 + 5 // dry run
+#define OPT_NMSI 2000 + 6 // nms iou
+
+#define OPT_CPUI 3000 + 1 // cpu info
+#define OPT_STGS 3000 + 2 // stage workers
+#define OPT_MEMB 3000 + 3 // memory budget
+
+#define OPT_INDX 4000 + 1 // label index
+#define OPT_LCCH 4000 + 2 // label cache
+#define OPT_COCO 4000 + 3 // coco file
+#define OPT_VOCN 4000 + 4 // voc names
 
 // debug level only when DEBUG is defined
 
@@ -187,3 +213,22 @@ void get_files_in_folder(const std::string &path,
  */
 unsigned count_files_in_folder(const std::string &path,
                                const std::string &fileext = "");
+
+/**
+ * @brief read a whole file
+ *
+ * @param path path to the file
+ * @param bytes content of the file (replaced)
+ * @return true - if the file could be read
+ */
+bool read_file(const std::string &path, std::vector<unsigned char> &bytes);
+
+/**
+ * @brief create or replace a file
+ *
+ * @param path path to the file
+ * @param bytes content of the file
+ * @return true - if the file was fully written
+ */
+bool write_file(const std::string &path,
+                const std::vector<unsigned char> &bytes);
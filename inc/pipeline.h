@@ -0,0 +1,334 @@
+#pragma once
+
+#include "lib.h"
+
+#include "pool.h"
+
+/**
+ * @brief FIFO queue between two stages of a pipeline, producers wait while
+ * it is full and consumers while it is empty
+ * @note the queue also measures its time-averaged length
+ *
+ */
+template <typename T> class BoundedQueue {
+private:
+  typedef std::chrono::steady_clock clock;
+
+  const size_t _capacity;
+  std::deque<T> _items;
+  bool _closed = false;
+
+  std::mutex _mutex;
+  std::condition_variable _not_empty, _not_full;
+
+  // integral of the length over time, since the construction
+  const clock::time_point _since;
+  clock::time_point _last;
+  double _area = 0;
+
+  // account for the length that held since the last change (locked)
+  void sample() {
+    const clock::time_point now = clock::now();
+    _area += _items.size() * std::chrono::duration<double>(now - _last).count();
+    _last = now;
+  }
+
+public:
+  /**
+   * @brief Construct a new BoundedQueue object
+   *
+   * @param capacity maximum number of queued items (at least 1)
+   */
+  explicit BoundedQueue(const size_t capacity)
+      : _capacity(std::max<size_t>(capacity, 1)), _since(clock::now()),
+        _last(_since) {}
+
+  size_t capacity() const { return _capacity; }
+
+  /**
+   * @brief queue an item, waiting for some room
+   *
+   * @param item the item, left untouched if the queue is closed
+   * @param waited incremented by the nanoseconds spent waiting
+   * @return true - if the item was queued, false if the queue is closed
+   */
+  bool push(T &&item, unsigned long long &waited) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_closed && _items.size() >= _capacity) {
+      const clock::time_point t0 = clock::now();
+      _not_full.wait(lock,
+                     [this] { return _closed || _items.size() < _capacity; });
+      waited += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - t0)
+                    .count();
+    }
+    if (_closed) return false;
+
+    sample();
+    _items.push_back(std::move(item));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief take the oldest item, waiting for one
+   *
+   * @param item the item (replaced)
+   * @param waited incremented by the nanoseconds spent waiting
+   * @return true - if an item was taken, false once closed and empty
+   */
+  bool pop(T &item, unsigned long long &waited) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_closed && _items.empty()) {
+      const clock::time_point t0 = clock::now();
+      _not_empty.wait(lock, [this] { return _closed || !_items.empty(); });
+      waited += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - t0)
+                    .count();
+    }
+    if (_items.empty()) return false;
+
+    sample();
+    item = std::move(_items.front());
+    _items.pop_front();
+    _not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief no more items will be pushed, the queued ones can still be taken
+   *
+   * @param drop also drop the queued items
+   */
+  void close(const bool drop = false) {
+    std::deque<T> dropped; // destroyed outside of the lock
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      sample();
+      _closed = true;
+      if (drop) dropped.swap(_items);
+    }
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+  /// @brief average number of queued items since the construction
+  double depth() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    sample();
+    const double elapsed =
+        std::chrono::duration<double>(_last - _since).count();
+    return elapsed > 0 ? _area / elapsed : 0;
+  }
+};
+
+/**
+ * @brief shared flag telling the workers of a pipeline to skip the work left,
+ * the items still flow through the stages so that every one of them is
+ * accounted for
+ *
+ */
+class CancelToken {
+private:
+  std::atomic<bool> _cancelled;
+
+public:
+  CancelToken() : _cancelled(false) {}
+
+  void cancel() { _cancelled = true; }
+  bool cancelled() const { return _cancelled; }
+};
+
+/**
+ * @brief bytes that the items of a pipeline may hold at once, an item that
+ * does not fit waits for others to be released
+ * @note a request that fits may overtake the oldest waiting one, so that the
+ * workers keep busy with small items while a large one waits for room, but
+ * only a few times in a row so that the large one is not overtaken forever
+ *
+ */
+class MemoryBudget {
+private:
+  const size_t _budget;      // 0 for no limit
+  const unsigned _overtakes; // requests let past the oldest waiting one
+  size_t _used = 0, _peak = 0;
+  unsigned long _next = 0;          // ticket of the next request
+  std::deque<unsigned long> _queue; // tickets of the waiting requests
+  unsigned _overtaken = 0;          // times the oldest one was overtaken
+
+  std::mutex _mutex;
+  std::condition_variable _released;
+
+public:
+  /**
+   * @brief Construct a new MemoryBudget object
+   *
+   * @param budget maximum number of bytes held at once (0 for no limit)
+   * @param overtakes number of requests that may overtake the oldest waiting
+   * one, before the others wait behind it
+   */
+  explicit MemoryBudget(const size_t budget, const unsigned overtakes = 8);
+
+  /**
+   * @brief hold some bytes, waiting for them to fit in the budget
+   * @note a request larger than the whole budget is let through once nothing
+   * else is held
+   *
+   * @param bytes number of bytes
+   * @param waited incremented by the nanoseconds spent waiting
+   * @return true - if the request is larger than the whole budget
+   */
+  bool acquire(const size_t bytes, unsigned long long &waited);
+
+  /// @brief give back bytes held by acquire()
+  void release(const size_t bytes);
+
+  /// @brief largest number of bytes held at once
+  size_t peak();
+};
+
+/**
+ * @brief split a sequence of items in contiguous ranges of similar weight,
+ * to hand them to several workers
+ *
+ * @param weights cost of each item (>= 0)
+ * @param parts maximum number of ranges
+ * @return std::vector<size_t> - bounds of the ranges, from 0 to the number
+ * of items (no range is empty)
+ */
+std::vector<size_t> split_ranges(const std::vector<double> &weights,
+                                 size_t parts);
+
+// number of composed pixels worth a crop batch of their own
+const double batch_pixels = 1 << 20;
+
+/**
+ * @brief split the crops of an image in batches for the workers of a crop
+ * stage, one batch per batch_pixels composed pixels, up to one per worker
+ * @note an image with less than batch_pixels composed pixels is left whole
+ *
+ * @param pixels composed pixels of each crop (0 for the ones that are not)
+ * @param workers number of workers of the crop stage
+ * @return std::vector<size_t> - bounds of the batches (see split_ranges)
+ */
+std::vector<size_t> split_batches(const std::vector<double> &pixels,
+                                  const int workers);
+
+/**
+ * @brief workers of one stage of a pipeline, taking the items of their input
+ * queue until it is closed and empty
+ * @note the workers run as tasks of a ThreadPool, each one holding a thread
+ * of the pool until the stage is done ; the time of the workers is split
+ * between working on an item, waiting for an input (starved) and waiting for
+ * room in an output queue (blocked)
+ *
+ */
+class Stage {
+private:
+  typedef std::chrono::steady_clock clock;
+
+  const std::string _name;
+  const int _workers;
+  std::vector<std::function<void()>> _loops; // one per worker
+
+  std::mutex _mutex;
+  std::condition_variable _left;
+  int _running = 0; // workers still taking items (guarded by _mutex)
+
+  std::atomic<unsigned long> _items;
+  std::atomic<unsigned long long> _active;  // ns spent on items
+  std::atomic<unsigned long long> _starved; // ns waiting for an input
+  std::atomic<unsigned long long> _blocked; // ns waiting for some room
+
+  // average length and capacity of the input queue
+  std::function<double()> _depth;
+  size_t _capacity = 0;
+
+public:
+  /**
+   * @brief Construct a new Stage object
+   *
+   * @param name name of the stage, for the report
+   * @param workers number of workers (at least 1)
+   */
+  Stage(const std::string &name, const int workers);
+  ~Stage();
+
+  Stage(const Stage &) = delete;
+  Stage &operator=(const Stage &) = delete;
+
+  int workers() const;
+
+  /**
+   * @brief start the workers
+   * @note the pool needs a thread for each worker of all the stages running
+   * at once, a worker waiting on a queue does not give its thread back
+   *
+   * @param pool the pool running the workers
+   * @param in the input queue, must outlive the stage
+   * @param work called with each item and the id of the worker in the stage
+   * @param last called by the last worker to leave (to close the next queue)
+   */
+  template <typename T, typename F, typename L>
+  void start(ThreadPool &pool, BoundedQueue<T> &in, F work, L last) {
+    _depth = [&in]() { return in.depth(); };
+    _capacity = in.capacity();
+    _running = _workers;
+
+    for (int id = 0; id < _workers; id++) {
+      _loops.emplace_back([this, &in, work, last, id]() mutable {
+        unsigned long long starved = 0;
+        T item;
+        while (in.pop(item, starved)) {
+          const clock::time_point t0 = clock::now();
+          work(item, id);
+          item = T(); // release the item before waiting for the next one
+          _active += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         clock::now() - t0)
+                         .count();
+          _items++;
+        }
+        _starved += starved;
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (--_running == 0) {
+          last();
+          _left.notify_all();
+        }
+      });
+    }
+    // the tasks only hold the stage, the loops are too large to be inlined
+    for (int id = 0; id < _workers; id++) {
+      pool.post([this, id](int) { _loops[id](); });
+    }
+  }
+
+  /**
+   * @brief pass an item to the next stage, from the work of this one
+   *
+   * @param out the output queue
+   * @param item the item
+   * @return true - if the item was queued, false if the queue is closed
+   */
+  template <typename T> bool emit(BoundedQueue<T> &out, T &&item) {
+    unsigned long long blocked = 0;
+    const bool queued = out.push(std::move(item), blocked);
+    if (blocked > 0) _blocked += blocked;
+    return queued;
+  }
+
+  /// @brief account for the work of this stage waiting on something else
+  void blocked_for(const unsigned long long ns);
+
+  /// @brief wait for the workers to leave
+  void join();
+
+  /**
+   * @brief describe how busy the stage was
+   * @note the workers must have left
+   *
+   * @param seconds duration of the run
+   * @return std::string - one line, without the newline
+   */
+  std::string report(const double seconds) const;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "lib.h"
+
+/**
+ * @brief type-erased `void(int)` callable, stored inline (never on the heap)
+ * @note the callable must fit in `capacity` bytes, capture pointers to the
+ * larger data
+ *
+ */
+class InlineTask {
+public:
+  static const size_t capacity = 48;
+
+private:
+  typedef std::aligned_storage<capacity, alignof(std::max_align_t)>::type
+      Storage;
+
+  Storage _storage;
+  void (*_call)(void *, int) = nullptr;
+  void (*_move)(void *, void *) = nullptr; // move to the first, destroy the second
+  void (*_destroy)(void *) = nullptr;
+
+  template <typename D> static void call(void *f, int id) {
+    (*static_cast<D *>(f))(id);
+  }
+  template <typename D> static void move(void *dst, void *src) {
+    new (dst) D(std::move(*static_cast<D *>(src)));
+    static_cast<D *>(src)->~D();
+  }
+  template <typename D> static void destroy(void *f) {
+    static_cast<D *>(f)->~D();
+  }
+
+public:
+  InlineTask() = default;
+
+  template <typename F,
+            typename D = typename std::decay<F>::type,
+            typename = typename std::enable_if<
+                !std::is_same<D, InlineTask>::value>::type>
+  InlineTask(F &&f)
+      : _call(&call<D>), _move(&move<D>), _destroy(&destroy<D>) {
+    static_assert(sizeof(D) <= capacity, "task too large to be stored inline");
+    static_assert(alignof(D) <= alignof(Storage), "task over-aligned");
+    new (&_storage) D(std::forward<F>(f));
+  }
+
+  InlineTask(InlineTask &&other) noexcept { *this = std::move(other); }
+
+  InlineTask &operator=(InlineTask &&other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    if (other._call != nullptr) {
+      other._move(&_storage, &other._storage);
+      _call = other._call;
+      _move = other._move;
+      _destroy = other._destroy;
+      other._call = nullptr;
+    }
+    return *this;
+  }
+
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+
+  ~InlineTask() { reset(); }
+
+  /// @brief destroy the callable, if any
+  void reset() {
+    if (_call == nullptr) return;
+    _destroy(&_storage);
+    _call = nullptr;
+  }
+
+  explicit operator bool() const { return _call != nullptr; }
+
+  void operator()(const int id) { _call(&_storage, id); }
+};
+
+/**
+ * @brief work-stealing thread pool, a drop-in for ctpl::thread_pool
+ * @note every worker owns a deque : it takes its own tasks from the front
+ * and, when it runs out, steals from the back of the others ; idle workers
+ * spin for a little while before parking on a condition variable ; tasks
+ * are stored inline in the deques, post() never allocates once reserve()
+ * made room for them
+ *
+ */
+class ThreadPool {
+public:
+  /// @brief a task, called with the id of the worker running it
+  typedef InlineTask Task;
+
+private:
+  // number of failed attempts to find a task before parking
+  static const int spin = 1 << 6;
+
+  // tasks of a worker, in a ring that only grows when it is full
+  struct Worker {
+    std::mutex mutex;
+    std::vector<Task> ring; // the capacity is a power of two
+    size_t head = 0, count = 0;
+
+    void grow(const size_t capacity);
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::thread> _threads;
+
+  std::atomic<size_t> _pending;    // tasks waiting in the deques
+  std::atomic<unsigned> _sleeping; // parked workers
+  std::atomic<unsigned> _next;     // round robin of the outside submissions
+  std::atomic<bool> _stop;
+
+  std::mutex _park_mutex;
+  std::condition_variable _park;
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void run(const int id);
+  bool pop(const int id, Task &task);
+  void submit(Task &&task);
+
+public:
+  /**
+   * @brief Construct a new ThreadPool object
+   *
+   * @param n number of workers (at least one)
+   */
+  explicit ThreadPool(int n);
+  /**
+   * @brief Destroy the ThreadPool object, after running the queued tasks
+   *
+   */
+  ~ThreadPool();
+
+  /// @brief number of workers
+  int size() const;
+
+  /**
+   * @brief make room for that many queued tasks, so that submitting them
+   * does not allocate
+   *
+   * @param tasks number of tasks
+   */
+  void reserve(const size_t tasks);
+
+  /**
+   * @brief queue a task without any allocation, its result (if any) is up to
+   * the task
+   *
+   * @param f the task, called with the id of the worker running it
+   */
+  template <typename F> void post(F &&f) { submit(Task(std::forward<F>(f))); }
+
+  /**
+   * @brief queue a task, on the deque of the calling worker if called from a
+   * task, or on the next deque otherwise
+   *
+   * @param f the task, called with the id of the worker running it
+   * @return std::future<R> - the result of the task
+   */
+  template <typename F> auto push(F &&f) -> std::future<decltype(f(0))> {
+    typedef decltype(f(0)) R;
+    auto task =
+        std::make_shared<std::packaged_task<R(int)>>(std::forward<F>(f));
+    submit(Task([task](int id) { (*task)(id); }));
+    return task->get_future();
+  }
+
+  /**
+   * @brief stop the workers and join them
+   *
+   * @param wait run the queued tasks first, otherwise they are dropped (the
+   * running ones always complete)
+   */
+  void stop(const bool wait = false);
+};
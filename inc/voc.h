@@ -0,0 +1,37 @@
+#pragma once
+
+#include "label.h"
+
+/**
+ * @brief one Pascal VOC annotation file per image, in a folder
+ * @note objects are converted like darknet's voc_label.py does: the class is
+ * the line of the object name in the names file, the 1-based pixel box is
+ * normalized with the image size, and difficult objects are dropped ; the
+ * confidence is always 1 ; the predefined XML entities of the names are
+ * decoded
+ *
+ */
+class VocFolder : public LabelSource {
+private:
+  std::string _path; // path to the folder, with a trailing '/'
+  std::unordered_map<std::string, int> _classes; // class id of each name
+  std::string _names;                            // all the names, in order
+  mutable std::atomic<unsigned long> _unknown;   // objects of unknown class
+
+public:
+  /**
+   * @brief Construct a new VocFolder object
+   * @note panics if the names file cannot be read
+   *
+   * @param path path to the folder, with a trailing '/'
+   * @param names path to the names file, one class name per line
+   */
+  VocFolder(const std::string &path, const std::string &names);
+
+  LabelStatus read(const std::string &stem,
+                   std::vector<Box> &boxes) const override;
+  std::string location(const std::string &stem) const override;
+  std::string signature() const override;
+  /// @brief number of objects dropped because of an unknown class name
+  unsigned long dropped() const override;
+};
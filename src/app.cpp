@@ -1,6 +1,9 @@
-#include "ctpl.hpp"
-
 #include "app.h"
+#include "coco.h"
+#include "kernels.h"
+#include "label.h"
+#include "pipeline.h"
+#include "voc.h"
 
 static void sig_handler(int signal) {
   static int64_t ms = 0;
@@ -48,11 +51,25 @@ static void print_help [[noreturn]] (const std::string &msg = "") {
      << "-h, --help\t\tdisplay this help and exit\n"
      << "-v, --version\t\tdisplay version and exit\n"
      << "-l, --license\t\tdisplay license and exit\n"
+     << "  , --cpu-info\t\tdisplay the selected cpu kernels and exit\n"
      << "-i, --in <>\t\tinput folder\n"
      << "-o, --out <>\t\toutput folder\n"
      << "-c, --cfg <>\t\tconfig folder (defaults to the input folder)\n"
+     << "  , --index <>\t\tsingle TSV/CSV label file, instead of the config "
+        "folder\n"
+     << "  , --coco <>\t\tCOCO JSON annotation file, instead of the config "
+        "folder\n"
+     << "  , --voc <>\t\tread Pascal VOC .xml files from the config folder, "
+        "with the class names of the given file\n"
+     << "  , --label-cache <>\tbinary cache of the config folder, compiled "
+        "again when stale\n"
      << "-e, --ext <>\t\timage file extension (defaults to .png)\n"
-     << "-t, --thrds <>\t\tmax number of threads (defaults to 8)\n"
+     << "-t, --thrds <>\t\tnumber of threads, shared by the stages (defaults "
+        "to 8, at least one per stage)\n"
+     << "  , --stages <>\t\tworkers of the stages from \"read, decode, crop, "
+        "encode, write\" (defaults to sharing t, 1/2/2/2/1 for 8)\n"
+     << "  , --mem-budget <>\tmaximum size of the images decoded at once, "
+        "with an optional K, M or G suffix (defaults to no limit)\n"
      << "-s, --size <>\t\tspecified size from \"min, max, w, h\" "
         "(defaults to no size restriction)\n"
      << "-p, --padd <>\t\tadd a little padding to the bounding box "
@@ -67,6 +84,10 @@ static void print_help [[noreturn]] (const std::string &msg = "") {
         "all)\n"
      << "  , --cnfd <>\t\tspecify a minimum confidence threshold "
         "(defaults to .5)\n"
+     << "  , --nms <>\t\tdrop the objects overlapping a better one of the "
+        "same class by more than this IoU (defaults to none)\n"
+     << "  , --dry-run\t\tonly report what would be cropped, without "
+        "decoding any image\n"
      << "  ,--trgt <>\t\ttarget minimum number of images to generate "
         "(defaults to no restriction)\n";
 
@@ -74,6 +95,34 @@ static void print_help [[noreturn]] (const std::string &msg = "") {
   std::exit(status);
 }
 
+/// @brief parse a number of bytes, with an optional K, M or G suffix
+static size_t parse_size(const char *arg) {
+  char *end = nullptr;
+  errno = 0;
+  const double value = strtod(arg, &end);
+  double unit = 1;
+  switch (end == nullptr ? '\0' : toupper(*end)) {
+  case 'K':
+    unit = 1024.0;
+    end++;
+    break;
+  case 'M':
+    unit = 1048576.0;
+    end++;
+    break;
+  case 'G':
+    unit = 1073741824.0;
+    end++;
+    break;
+  default:
+    break;
+  }
+  if (end == arg || *end != '\0' || errno != 0 || !(value >= 0)) {
+    panic("invalid argument for --mem-budget from " + std::string(arg));
+  }
+  return static_cast<size_t>(value * unit);
+}
+
 static void print_version [[noreturn]] () {
   std::stringstream ss;
   ss << "YOLO_crop\n"
@@ -85,6 +134,11 @@ static void print_version [[noreturn]] () {
   std::exit(EXIT_SUCCESS);
 }
 
+static void print_cpu_info [[noreturn]] () {
+  std::cout << kernels_info() << std::flush;
+  std::exit(EXIT_SUCCESS);
+}
+
 static void print_license [[noreturn]] () {
   static const char l[] =
       "This project is licensed under the [GPL-3.0](LICENSE) license. "
@@ -140,7 +194,17 @@ App::App(int argc, char *argv[]) {
         {"trgt", required_argument, nullptr, OPT_TRGT},
         {"help", no_argument, nullptr, 'h'},
         {"version", no_argument, nullptr, 'v'},
-        {"license", no_argument, nullptr, 'l'}, {nullptr, 0, nullptr, 0},
+        {"license", no_argument, nullptr, 'l'},
+        {"cpu-info", no_argument, nullptr, OPT_CPUI},
+        {"index", required_argument, nullptr, OPT_INDX},
+        {"label-cache", required_argument, nullptr, OPT_LCCH},
+        {"coco", required_argument, nullptr, OPT_COCO},
+        {"voc", required_argument, nullptr, OPT_VOCN},
+        {"dry-run", no_argument, nullptr, OPT_DRYR},
+        {"nms", required_argument, nullptr, OPT_NMSI},
+        {"stages", required_argument, nullptr, OPT_STGS},
+        {"mem-budget", required_argument, nullptr, OPT_MEMB},
+        {nullptr, 0, nullptr, 0},
   };
   static const char *short_options = "i:o:c:e:t:s:b:p:hvl";
 
@@ -159,6 +223,7 @@ App::App(int argc, char *argv[]) {
       break;
     case 'c':
       _path_to_config_folder = optarg;
+      _config_folder_is_set = true;
       break;
     case 'e':
       _image_ext = optarg;
@@ -166,6 +231,17 @@ App::App(int argc, char *argv[]) {
     case 't':
       _max_threads = std::stoul(optarg);
       break;
+    case OPT_MEMB:
+      _mem_budget = parse_size(optarg);
+      break;
+    case OPT_STGS:
+      err = sscanf(optarg, "%d, %d, %d, %d, %d", &_read_threads,
+                   &_decode_threads, &_crop_threads, &_encode_threads,
+                   &_write_threads);
+      if (err == EOF) {
+        panic("invalid argument for --stages from " + std::string(optarg));
+      }
+      break;
     case 's':
       err = sscanf(optarg, "%d, %d, %d, %d", &_min_object_size,
                    &_max_object_size, &_target_width, &_target_height);
@@ -212,6 +288,25 @@ App::App(int argc, char *argv[]) {
       _min_target_images = std::stol(optarg);
       _min_target_images_is_set = true;
       break;
+    case OPT_INDX:
+      _path_to_label_index = optarg;
+      break;
+    case OPT_LCCH:
+      _path_to_label_cache = optarg;
+      break;
+    case OPT_COCO:
+      _path_to_coco_file = optarg;
+      break;
+    case OPT_VOCN:
+      _path_to_voc_names = optarg;
+      break;
+    case OPT_DRYR:
+      _dry_run = true;
+      break;
+    case OPT_NMSI:
+      _nms_iou = std::stod(optarg);
+      _nms_iou_is_set = true;
+      break;
     case 'h':
       print_help();
       panic("unreachable");
@@ -221,6 +316,9 @@ App::App(int argc, char *argv[]) {
     case 'l':
       print_license();
       panic("unreachable");
+    case OPT_CPUI:
+      print_cpu_info();
+      panic("unreachable");
     default:
       bad_opt = std::string(argv[optind - 1]);
       ss.clear();
@@ -243,9 +341,27 @@ void App::check_args() {
   if (_path_to_input_folder.empty()) {
     print_help("missing input folder\n");
   }
-  if (_path_to_output_folder.empty()) {
+  if (_path_to_output_folder.empty() && !_dry_run) {
     print_help("missing output folder\n");
   }
+  // the single file label sources replace the config folder
+  const unsigned label_files =
+      !_path_to_label_index.empty() + !_path_to_coco_file.empty();
+  if (label_files > 1) {
+    print_help("specifying more than one label file is not allowed\n");
+  }
+  if (label_files > 0 && _config_folder_is_set) {
+    print_help("labels are read from a single file\n"
+               "(--cfg is useless here)\n");
+  }
+  if (label_files > 0 && !_path_to_voc_names.empty()) {
+    print_help("labels are read from a single file\n"
+               "(--voc is useless here)\n");
+  }
+  if (label_files > 0 && !_path_to_label_cache.empty()) {
+    print_help("labels are read from a single file\n"
+               "(--label-cache is useless here)\n");
+  }
   if (_path_to_config_folder.empty()) {
     _path_to_config_folder = _path_to_input_folder;
   }
@@ -289,6 +405,9 @@ void App::check_args() {
   if (_min_confidence < 0 || _min_confidence > 1) {
     print_help("minimum confidence must be between 0 and 1\n");
   }
+  if (_nms_iou_is_set && (_nms_iou < 0 || _nms_iou > 1)) {
+    print_help("non maximum suppression IoU must be between 0 and 1\n");
+  }
   if (_class_id_is_set && _class_id < 0) {
     print_help("please let class id be EOF by not setting --clss manually\n");
   }
@@ -296,6 +415,32 @@ void App::check_args() {
     print_help("please let target id be EOF by not setting --trgt manually\n");
   }
 
+  // the stages left unset share what the set ones left of the threads, one
+  // worker each and then the rest in turn, the file accesses getting half
+  // the share of the codecs (1/2/2/2/1 for 8 threads)
+  int *stages[] = {&_read_threads, &_decode_threads, &_crop_threads,
+                   &_encode_threads, &_write_threads};
+  static const int turns[] = {3, 1, 2, 3, 1, 2, 0, 4};
+  int left = static_cast<int>(_max_threads);
+  bool unset[5] = {};
+  for (int s = 0; s < 5; s++) {
+    if (*stages[s] != EOF && *stages[s] <= 0) {
+      print_help("stage workers must be > 0\n");
+    }
+    unset[s] = *stages[s] == EOF;
+    if (unset[s]) *stages[s] = 1;
+    left -= *stages[s];
+  }
+  if (unset[0] || unset[1] || unset[2] || unset[3] || unset[4]) {
+    for (int k = 0; left > 0; k++) {
+      const int s = turns[k % 8];
+      if (unset[s]) {
+        (*stages[s])++;
+        left--;
+      }
+    }
+  }
+
   if (_lock && _image_shape == ImageShape::undefined &&
       !_path_to_background_image.empty()) {
     print_help("locking cropping feature without any specific shape "
@@ -346,247 +491,486 @@ void create_dir(const std::string &path) {
   }
 }
 
-/// @brief holds the necessary information for a single image
+/// @brief counters shared by all the workers of a run
+struct process_stats {
+  std::atomic<unsigned> decoded; // number of decoded source images
+  std::atomic<unsigned> skipped; // number of images we did not need to decode
+  std::atomic<unsigned long> suppressed; // number of overlapping objects
+
+  std::mutex mutex;     // guards the summary
+  crop_summary summary; // only filled by dry runs
+
+  process_stats() : decoded(0), skipped(0), suppressed(0) {}
+};
+
+/// @brief holds the parameters shared by all the images of a run
 struct process_args {
-  std::string img_path, cfg_path, out_path, img_name, img_ext;
+  std::string in_path, out_path, img_ext;
   int min_object_size, max_object_size, target_width, target_height,
       horizontal_padding, vertical_padding, class_id;
-  bool lock;
-  unsigned img_num;
-  double min_confidence;
+  bool lock, dry_run;
+  double min_confidence, nms_iou;
   ImageShape image_shape;
   Image *background_image;
+  const LabelSource *labels;
+  process_stats *stats;
 
   process_args()
-      : img_path(""), cfg_path(""), out_path(""), img_name(""), img_ext(""),
-        min_object_size(EOF), max_object_size(EOF), target_width(EOF),
-        target_height(EOF), horizontal_padding(EOF), vertical_padding(EOF),
-        class_id(EOF), lock(false), img_num(0), min_confidence(0.5),
-        image_shape(ImageShape::undefined), background_image(nullptr) {}
+      : in_path(""), out_path(""), img_ext(""), min_object_size(EOF),
+        max_object_size(EOF), target_width(EOF), target_height(EOF),
+        horizontal_padding(EOF), vertical_padding(EOF), class_id(EOF),
+        lock(false), dry_run(false), min_confidence(0.5), nms_iou(EOF),
+        image_shape(ImageShape::undefined), background_image(nullptr),
+        labels(nullptr), stats(nullptr) {}
+};
+
+/// @brief one crop, resolved against the dimensions of the source image
+struct Crop {
+  int cls;          // the class id of the object
+  int center_x;     // the center x coordinate, in the range [0, w]
+  int center_y;     // the center y coordinate, in the range [0, h]
+  int x;            // the top-left x coordinate of the shape
+  int y;            // the top-left y coordinate of the shape
+  int shape_width;  // width of the shape cut from the source
+  int shape_height; // height of the shape cut from the source
+  int width;        // width of the generated image
+  int height;       // height of the generated image
+  bool inside;      // the shape fills the generated image, inside the source
+};
+
+/// @brief an image going through the stages of a run, shared by its crops
+struct ImageJob {
+  unsigned num;                        // index of the image in the run
+  std::string name;                    // file name, without the extension
+  std::string path;                    // path to the image file
+  std::vector<Crop> crops;          // resolved from the header
+  std::vector<unsigned char> bytes; // the image file, until decoded
+  size_t decoded_size;              // estimated from the header
+
+  std::atomic<size_t> pending;  // crops not written yet
+  std::atomic<ssize_t> written; // number correctly generated images
+  std::atomic<bool> failed;     // some error was logged for this image
+
+  ImageJob()
+      : num(0), decoded_size(0), pending(0), written(0), failed(false) {}
+};
+
+/// @brief some of the crops of a decoded image, for a worker of the crop stage
+struct CropBatch {
+  std::shared_ptr<ImageJob> image;
+  std::shared_ptr<const Image> source; // freed along with the last crop
+  size_t begin, end;                   // range of image->crops
 };
 
-static ssize_t process(const struct process_args p_args /* copy */) {
-  const std::string img_path = p_args.img_path;
-  const std::string cfg_path = p_args.cfg_path;
-  const std::string out_path = p_args.out_path;
-  const std::string img_name = p_args.img_name;
-  const std::string img_ext = p_args.img_ext;
-  const int min_object_size = p_args.min_object_size;
-  const int max_object_size = p_args.max_object_size;
-  const int target_width = p_args.target_width;
-  const int target_height = p_args.target_height;
-  const int horizontal_padding = p_args.horizontal_padding;
-  const int vertical_padding = p_args.vertical_padding;
-  const int class_id = p_args.class_id;
-  const bool lock = p_args.lock;
-  const ImageShape image_shape = p_args.image_shape;
-  const Image *background_image = p_args.background_image;
-  const double min_confidence = p_args.min_confidence;
-  const unsigned img_num = p_args.img_num;
+/**
+ * @brief split the crops of an image in batches for the workers of the crop
+ * stage, a large image with many crops is not left to a single worker
+ *
+ * @param crops the crops of the image
+ * @param workers number of workers of the crop stage
+ * @return std::vector<size_t> - bounds of the batches in crops
+ */
+static std::vector<size_t> batches(const std::vector<Crop> &crops,
+                                   const int workers) {
+  // only the composed crops cost anything in the crop stage, the crops
+  // inside the source are viewed
+  std::vector<double> pixels(crops.size());
+  for (size_t k = 0; k < crops.size(); k++) {
+    const Crop &crop = crops[k];
+    pixels[k] = crop.inside ? 0 : static_cast<double>(crop.width) * crop.height;
+  }
+  return split_batches(pixels, workers);
+}
 
+/// @brief one crop of an image going through the last stages of a run
+struct CropJob {
+  std::shared_ptr<ImageJob> image;
+  size_t k;                            // index of the crop in image->crops
+  std::shared_ptr<const Image> source; // viewed in place if the crop is inside
+  Image subject;                       // composed otherwise
+  std::vector<unsigned char> bytes;    // the encoded crop
+};
+
+/**
+ * @brief composed crops handed back by the encode stage once encoded, so that
+ * the crop stage composes the next ones in their buffers
+ * @note the buffers come from the pools of the crop workers, which they go
+ * back to when they are too small ; the bin holds at most the crops that were
+ * in flight at once
+ *
+ */
+class Spares {
+private:
+  std::mutex _mutex;
+  std::vector<Image> _images;
+
+public:
+  /// @brief a spare crop to compose in, or an empty image
+  Image take() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_images.empty()) return Image();
+    Image image = std::move(_images.back());
+    _images.pop_back();
+    return image;
+  }
+
+  /// @brief hand an encoded crop back
+  void give(Image &&image) {
+    if (image.data() == nullptr) return;
+    std::lock_guard<std::mutex> guard(_mutex);
+    _images.push_back(std::move(image));
+  }
+};
+
+/**
+ * @brief read the objects of an image and resolve its crops, from the header
+ * of the image only
+ * @note the image file itself is read too, unless nothing is to be decoded
+ *
+ * @param p the parameters of the run
+ * @param num index of the image
+ * @param file file name of the image, in the input folder
+ * @return std::shared_ptr<ImageJob> - the image
+ */
+static std::shared_ptr<ImageJob> prepare(const process_args &p,
+                                         const unsigned num,
+                                         const std::string &file) {
   const int min_padding = // minimum padding if padding is set, otherwise 0
-      std::min((horizontal_padding == EOF) ? 0 : horizontal_padding,
-               (vertical_padding == EOF) ? 0 : vertical_padding);
+      std::min((p.horizontal_padding == EOF) ? 0 : p.horizontal_padding,
+               (p.vertical_padding == EOF) ? 0 : p.vertical_padding);
   const int max_padding = // maximum padding if padding is set, otherwise 0
-      std::max((horizontal_padding == EOF) ? 0 : horizontal_padding,
-               (vertical_padding == EOF) ? 0 : vertical_padding);
+      std::max((p.horizontal_padding == EOF) ? 0 : p.horizontal_padding,
+               (p.vertical_padding == EOF) ? 0 : p.vertical_padding);
   const int min_size = // minimum object size if object size is set, otherwise 0
-      (min_object_size == EOF) ? 0 : min_object_size + 2 * min_padding;
+      (p.min_object_size == EOF) ? 0 : p.min_object_size + 2 * min_padding;
   const int max_size = // maximum object size if object size is set, otherwise 0
-      (max_object_size == EOF) ? 0 : max_object_size + 2 * max_padding;
-
-  volatile ssize_t count = 0; // number correctly generated images
-  int status = EXIT_SUCCESS;  // status return code
-  int err = 0;                // error on sscanf
-  int channel_force =         // force channel to be set to this value
-      background_image == nullptr ? 0 : background_image->channels();
-  const Image source = Image(img_path, channel_force);
-
-  std::ifstream cfg_file;
-  cfg_file.open(cfg_path + img_name + ".txt", std::ios::out);
-  if (!cfg_file.is_open()) {
-    log("could not open config file '" + cfg_path + img_name + ".txt'\n",
+      (p.max_object_size == EOF) ? 0 : p.max_object_size + 2 * max_padding;
+
+  std::shared_ptr<ImageJob> job = std::make_shared<ImageJob>();
+  job->num = num;
+  job->name = file.substr(0, file.find_last_of('.'));
+  job->path = p.in_path + file;
+
+  // read the objects of the image, before decoding anything
+  std::vector<Box> boxes; // the objects of the config file
+  switch (p.labels->read(job->name, boxes)) {
+  case LabelStatus::unreadable:
+    job->failed = true;
+    log("could not open config file '" + p.labels->location(job->name) +
+            "'\n",
+        LogLevel::error);
+    break;
+  case LabelStatus::malformed:
+    job->failed = true;
+    log("could not parse config file for image '" + job->path + "'\n",
         LogLevel::error);
-    status = EXIT_FAILURE;
+    break; // the objects before the blank line are still cropped
+  default:
+    break;
   }
 
-  // "class, x, y, width, height, confidence"
-  static const char pattern[] = "%d %lf %lf %lf %lf %lf";
-  std::string line; // one line of the config file
+  crop_summary summary; // what this image would produce
+  summary.objects = boxes.size();
 
-  const int w = source.width();  // width of the source image
-  const int h = source.height(); // height of the source image
+  auto filtered = [&p](const Box &box) {
+    return (p.class_id != EOF && box.cls != p.class_id) ||
+           box.score < p.min_confidence;
+  }; // the label-only filters
+  boxes.erase(std::remove_if(boxes.begin(), boxes.end(), filtered),
+              boxes.end());
+  summary.kept = boxes.size();
 
-  int bg_w = -1, bg_h = -1;
-  if (background_image != nullptr) {
-    bg_w = background_image->width();  // width of the background image
-    bg_h = background_image->height(); // height of the background image
+  // only the best of the overlapping objects of a class is cropped
+  if (p.nms_iou >= 0) {
+    p.stats->suppressed += suppress_overlaps(boxes, p.nms_iou);
   }
 
-  int _cls;      // the class id of the object
-  double _cx;    // the center x coordinate, in the range [0, 1]
-  double _cy;    // the center y coordinate, in the range [0, 1]
-  double _w;     // the width, in the range [0, 1]
-  double _h;     // the height, in the range [0, 1]
-  double _score; // the confidence of the object
-
-  int center_x; // the center x coordinate, in the range [0, w]
-  int center_y; // the center y coordinate, in the range [0, w]
-  int i;        // the top-left x coordinate, in the range [0, w]
-  int j;        // the top-right x coordinate, in the range [0, w]
-  int width;    // width (the desired or the one of the object)
-  int height;   // height (the desired or the one of the object)
-  int _width;   // the width of the object, in the range [0, w]
-  int _height;  // he height of the object, in the range [0, h]
-  int _r;       // minimum radius of the object, in the range [0, w]
-
-  // read cfg_file line by line
-  while (std::getline(cfg_file, line) /* boolean on conversion */) {
-
-    err = sscanf(line.c_str(), pattern, &_cls, &_cx, &_cy, &_w, &_h, &_score);
-    if (err == EOF) break;
-
-    if (class_id != EOF && _cls != class_id) continue;
-    if (_score < min_confidence) continue;
-
-    _width = round_to_int(lerp(0, w, _w)) +
-             (horizontal_padding == EOF ? 0 : horizontal_padding * 2);
-    _height = round_to_int(lerp(0, h, _h)) +
-              (vertical_padding == EOF ? 0 : vertical_padding * 2);
+  // resolve the geometry of every crop from the image header only
+  std::vector<Crop> &crops = job->crops;
+  int w = 0, h = 0, c = 0; // dimensions of the source image
+
+  if (!boxes.empty()) {
+    const bool header = p.dry_run
+                            ? Image::probe(job->path, w, h, c)
+                            : read_file(job->path, job->bytes) &&
+                                  Image::probe(job->bytes.data(),
+                                               job->bytes.size(), w, h, c);
+    if (!header) panic("failed to read image header from " + job->path);
+  }
+  const int channel_force = // force channel to be set to this value
+      p.background_image == nullptr ? 0 : p.background_image->channels();
+  job->decoded_size = static_cast<size_t>(w) * h *
+                      (channel_force == 0 ? c : channel_force);
+
+  int _width;  // the width of the object, in the range [0, w]
+  int _height; // the height of the object, in the range [0, h]
+  int _r;      // minimum radius of the object, in the range [0, w]
+
+  for (const Box &b : boxes) {
+    Crop crop;
+    crop.cls = b.cls;
+
+    _width = round_to_int(lerp(0, w, b.w)) +
+             (p.horizontal_padding == EOF ? 0 : p.horizontal_padding * 2);
+    _height = round_to_int(lerp(0, h, b.h)) +
+              (p.vertical_padding == EOF ? 0 : p.vertical_padding * 2);
     _r = std::min(_width, _height);
+    summary.object_sizes[crop_summary::bucket(_r)]++;
 
-    if (min_object_size > 0 && min_size > std::min(_width, _height)) {
+    if (p.min_object_size > 0 && min_size > std::min(_width, _height)) {
       continue;
     }
-    if (max_object_size > 0 && max_size < std::max(_width, _height)) {
+    if (p.max_object_size > 0 && max_size < std::max(_width, _height)) {
       continue;
     }
 
-    width = target_width <= 0 ? _width : target_width;
-    height = target_height <= 0 ? _height : target_height;
-    center_x = round_to_int(lerp(0, w, _cx));
-    center_y = round_to_int(lerp(0, h, _cy));
+    crop.width = p.target_width <= 0 ? _width : p.target_width;
+    crop.height = p.target_height <= 0 ? _height : p.target_height;
+    crop.center_x = round_to_int(lerp(0, w, b.cx));
+    crop.center_y = round_to_int(lerp(0, h, b.cy));
 
     // continue if locking blocks cropping feature
-    if (lock) {
-      if (center_x - width / 2 < 0 || center_x + width / 2 > w ||
-          center_y - height / 2 < 0 || center_y + height / 2 > h) {
+    if (p.lock) {
+      if (crop.center_x - crop.width / 2 < 0 ||
+          crop.center_x + crop.width / 2 > w ||
+          crop.center_y - crop.height / 2 < 0 ||
+          crop.center_y + crop.height / 2 > h) {
         continue;
       }
     }
 
-    // the base image (either blank or background image)
-    Image *dest = nullptr;
-    if (background_image != nullptr) {
-      dest = background_image->crop_rect(bg_w / 2 - width / 2,
-                                         bg_h / 2 - height / 2, width, height);
-    }
+    // by default, we do not crop according to the bounding box
+    crop.shape_width = crop.width;
+    crop.shape_height = crop.height;
 
-    // the cropped image (can use dest as a base)
-    Image *subject = nullptr;
-    // there might be a better way to do this...
-    switch (image_shape) {
-    case ImageShape::undefined: // we do not crop according to the bounding box
-      i = center_x - width / 2;
-      j = center_y - height / 2;
-      subject = source.crop_rect(i, j, width, height, dest);
-      break;
+    switch (p.image_shape) {
     case ImageShape::square: // square inside the bounding box
-      i = center_x - _r / 2;
-      j = center_y - _r / 2;
-      subject = source.crop_rect(i, j, _r, _r, dest, width, height);
+    case ImageShape::circle: // circle inside the bounding box
+      crop.shape_width = _r;
+      crop.shape_height = _r;
       break;
     case ImageShape::rectangle: // the bounding box itself
-      i = center_x - _width / 2;
-      j = center_y - _height / 2;
-      subject = source.crop_rect(i, j, _width, _height, dest, width, height);
+    case ImageShape::ellipse:   // ellipse inside the bounding box
+      crop.shape_width = _width;
+      crop.shape_height = _height;
       break;
-    case ImageShape::circle: // circle inside the bounding box
-      i = center_x - _r / 2;
-      j = center_y - _r / 2;
-      subject = source.crop_ellipse(i, j, _r, _r, dest, width, height);
-      break;
-    case ImageShape::ellipse: // ellipse inside the bounding box
-      i = center_x - _width / 2;
-      j = center_y - _height / 2;
-      subject = source.crop_ellipse(i, j, _width, _height, dest, width, height);
+    default:
       break;
     }
+    crop.x = crop.center_x - crop.shape_width / 2;
+    crop.y = crop.center_y - crop.shape_height / 2;
+
+    // a rectangle that needs neither background nor mask can be viewed
+    crop.inside = p.image_shape != ImageShape::circle &&
+                  p.image_shape != ImageShape::ellipse &&
+                  crop.shape_width == crop.width &&
+                  crop.shape_height == crop.height && crop.x >= 0 &&
+                  crop.y >= 0 && crop.x + crop.width <= w &&
+                  crop.y + crop.height <= h;
+
+    crops.push_back(crop);
+  }
 
-    if (subject == nullptr) {
-      log("could not crop image '" + img_path + "' to " +
-              shape_to_string(image_shape) + '\n',
-          LogLevel::error);
-      status = EXIT_FAILURE;
-      if (dest != nullptr) delete dest;
-      continue;
-    } // big oops
-
-    // save the image
-    const std::string subject_name =
-        out_path + img_name + '_' + std::to_string(_cls) + '_' +
-        std::to_string(center_x) + '_' + std::to_string(center_y) + '_' +
-        std::to_string(count) + '_' + std::to_string(img_num) + img_ext;
-    if (!subject->write(subject_name)) {
-      status = EXIT_FAILURE;
-      log("could not write image '" + subject_name + "'\n", LogLevel::error);
-    } else {
-      count++; // saving was successful, increment the counter
+  if (p.dry_run) {
+    const int channels = channel_force == 0 ? c : channel_force;
+    for (const Crop &crop : crops) {
+      summary.crop_sizes[crop_summary::bucket(
+          std::max(crop.width, crop.height))]++;
+      summary.classes[crop.cls]++;
+      summary.bytes += static_cast<unsigned long long>(crop.width) *
+                       crop.height * channels;
     }
-    delete subject; // which will delete dest if it was not nullptr
+    summary.crops = crops.size();
+    summary.images = crops.empty() ? 0 : 1;
+    job->written = crops.size(); // the images that would be created
+
+    std::lock_guard<std::mutex> guard(p.stats->mutex);
+    p.stats->summary.merge(summary);
+  } else if (crops.empty()) {
+    // no crop survived the filters, so there is no need to decode the image
+    p.stats->skipped++;
   }
+  return job;
+}
 
-  if (err == EOF) {
-    status = EXIT_FAILURE;
-    log("could not parse config file for image '" + img_path + "'\n",
-        LogLevel::error);
-  } // sscanf failed, break fallthrough
-
-  if (cfg_file.is_open()) {
-    cfg_file.close();
-    if (cfg_file.fail() && !cfg_file.eof()) {
-      status = EXIT_FAILURE;
-      log("could not close config file '" + cfg_path + img_name + ".txt'\n",
-          LogLevel::error);
-    } // could not close the file
-  }   // if the file was open, close it
-
-  if (status == EXIT_FAILURE) {
+/// @brief the crops left before --trgt is reached, claimed one at a time
+class CropQuota {
+private:
+  const ssize_t _target; // EOF for no target
+  CancelToken &_token;   // cancelled once the target is reached
+  std::atomic<ssize_t> _claimed;
+  std::atomic<long> _owner; // the only image cropped for a target of 0
+
+public:
+  CropQuota(const ssize_t target, CancelToken &token)
+      : _target(target), _token(token), _claimed(0), _owner(EOF) {}
+
+  /**
+   * @brief claim the next crop of an image
+   * @note a target of 0 stands for all the crops of a single image
+   *
+   * @param num index of the image
+   * @return true - if the crop is to be made
+   */
+  bool claim(const unsigned num) {
+    if (_target == EOF) return true;
+    if (_target == 0) {
+      long none = EOF;
+      _owner.compare_exchange_strong(none, static_cast<long>(num));
+      _token.cancel(); // no other image is to be decoded
+      return _owner == static_cast<long>(num);
+    }
+    const ssize_t k = _claimed++;
+    if (k + 1 >= _target) _token.cancel();
+    return k < _target;
+  }
+};
+
+/**
+ * @brief compose a crop that is not inside of the source, over the background
+ * image if any
+ *
+ * @param p the parameters of the run
+ * @param source the decoded image
+ * @param crop the crop
+ * @param subject the cropped image
+ */
+static void compose(const process_args &p, const Image &source,
+                    const Crop &crop, Image &subject) {
+  switch (p.image_shape) {
+  case ImageShape::undefined:
+  case ImageShape::square:
+  case ImageShape::rectangle:
+    source.crop_rect(subject, crop.x, crop.y, crop.shape_width,
+                     crop.shape_height, p.background_image, crop.width,
+                     crop.height);
+    break;
+  case ImageShape::circle:
+  case ImageShape::ellipse:
+    source.crop_ellipse(subject, crop.x, crop.y, crop.shape_width,
+                        crop.shape_height, p.background_image, crop.width,
+                        crop.height);
+    break;
+  }
+}
+
+/// @brief path of the k-th crop of an image
+static std::string crop_path(const process_args &p, const ImageJob &job,
+                             const size_t k) {
+  const Crop &crop = job.crops[k];
+  return p.out_path + job.name + '_' + std::to_string(crop.cls) + '_' +
+         std::to_string(crop.center_x) + '_' + std::to_string(crop.center_y) +
+         '_' + std::to_string(k) + '_' + std::to_string(job.num) + p.img_ext;
+}
+
+/// @brief an image that went through the pipeline
+struct Completion {
+  unsigned num;   // index of the image
+  ssize_t images; // number correctly generated images
+};
+
+/// @brief the images that went through the pipeline, in the order they did
+typedef BoundedQueue<Completion> Completions;
+
+/// @brief hand the number of generated images of an image over
+static void finish(const process_args &p, const ImageJob &job,
+                   Completions &completed) {
+  if (job.failed) {
     // instead of returning the status and then loging the error
     // we acknowledge errors and return the number of correctly saved images
-    log("error(s) processing image '" + img_name + img_ext + "'\n",
+    log("error(s) processing image '" + job.name + p.img_ext + "'\n",
         LogLevel::error);
   }
+  // the queue has room for all the images, this never waits
+  unsigned long long unused = 0;
+  completed.push(Completion{job.num, job.written}, unused);
+}
 
-  return count;
+/// @brief account for crops of an image that will not be made
+static void skip(const process_args &p, ImageJob &job, const size_t crops,
+                 Completions &completed) {
+  if (crops > 0 && job.pending.fetch_sub(crops) == crops) {
+    finish(p, job, completed);
+  }
 }
 
-int App::run() {
-  using namespace ctpl;
+/// @brief account for a crop leaving the pipeline, written or not
+static void done(const process_args &p, const CropJob &cj, const bool written,
+                 Completions &completed) {
+  ImageJob &job = *cj.image;
+  if (!written) {
+    job.failed = true;
+    log("could not write image '" + crop_path(p, job, cj.k) + "'\n",
+        LogLevel::error);
+  } else {
+    job.written++; // saving was successful, increment the counter
+  }
+  if (--job.pending == 0) finish(p, job, completed);
+}
+
+/// @brief print the summary of a dry run
+static void print_summary(const crop_summary &s, const unsigned n) {
+  auto range = [](const int b) {
+    if (b == 0) return std::string("< 16");
+    if (b == crop_summary::buckets - 1) {
+      return ">= " + std::to_string(16 << (b - 1));
+    }
+    return std::to_string(16 << (b - 1)) + '-' + std::to_string(16 << b);
+  };
 
+  std::stringstream ss;
+  ss << "dry run\n"
+     << "  images:             " << n << " (" << s.images
+     << " with at least one crop)\n"
+     << "  objects:            " << s.objects << '\n'
+     << "  after class/cnfd:   " << s.kept << '\n'
+     << "  crops:              " << s.crops << '\n'
+     << "  uncompressed bytes: " << s.bytes << " (" << std::fixed
+     << std::setprecision(1) << s.bytes / 1048576.0 << " MiB)\n";
+
+  ss << "  size   objects (smaller side)   crops (larger side)\n";
+  for (int b = 0; b < crop_summary::buckets; b++) {
+    if (s.object_sizes[b] == 0 && s.crop_sizes[b] == 0) continue;
+    ss << "  " << std::left << std::setw(11) << range(b) << std::right
+       << std::setw(12) << s.object_sizes[b] << std::setw(22)
+       << s.crop_sizes[b] << '\n';
+  }
+
+  ss << "  class  crops\n";
+  for (const auto &c : s.classes) {
+    ss << "  " << std::left << std::setw(7) << c.first << std::right
+       << c.second << '\n';
+  }
+
+  std::cout << ss.str() << std::flush;
+}
+
+int App::run() {
   std::signal(SIGINT, sig_handler);
 
   // get the list of files in the input folder
   std::vector<std::string> imgs_files;
 
   get_files_in_folder(_path_to_input_folder, imgs_files, _image_ext);
-  create_dir(_path_to_output_folder);
+  if (!_dry_run) create_dir(_path_to_output_folder);
 
   const unsigned n = imgs_files.size();
-  unsigned idx = 0;
+  unsigned idx = 0; // number of images that went through
 
   // figure out if we need a 's' at "image(s)"
   const char sf = n > 1u ? 's' : ' ';
 
   log("found " + std::to_string(n) + " image" + sf + '\n', LogLevel::info);
 
-  // thread pool
-  thread_pool tp(_max_threads);
-  std::vector<std::future<ssize_t>> futures(n);
+  // the number of generated images of each image, as soon as it is known
+  Completions completed(n);
+  _report = RunReport();
+  _report.order.reserve(n);
 
   // constant parameters for all images
 
   struct process_args p_args;
+  p_args.in_path = _path_to_input_folder + '/';
   p_args.out_path = _path_to_output_folder + '/';
   p_args.img_ext = _image_ext;
   p_args.min_object_size = _min_object_size;
@@ -597,8 +981,58 @@ int App::run() {
   p_args.horizontal_padding = _horizontal_padding;
   p_args.vertical_padding = _vertical_padding;
   p_args.lock = _lock;
+  p_args.dry_run = _dry_run;
   p_args.class_id = _class_id;
   p_args.min_confidence = _min_confidence;
+  p_args.nms_iou = _nms_iou;
+
+  process_stats stats; // shared by all workers
+  p_args.stats = &stats;
+
+  // where the objects are read from, shared read-only by all workers
+  std::unique_ptr<LabelSource> files; // the per-image label files, if any
+  std::unique_ptr<LabelSource> labels;
+  if (!_path_to_label_index.empty() || !_path_to_coco_file.empty()) {
+    LabelTable *table;
+    if (!_path_to_label_index.empty()) {
+      table = new LabelIndex(_path_to_label_index);
+    } else {
+      CocoIndex *coco = new CocoIndex(_path_to_coco_file);
+      if (coco->orphans() > 0) {
+        log(std::to_string(coco->orphans()) +
+                " annotation(s) without a known image size\n",
+            LogLevel::warning);
+      }
+      table = coco;
+    }
+    log("indexed " + std::to_string(table->rows()) + " object(s) of " +
+            std::to_string(table->images()) + " image(s)\n",
+        LogLevel::info);
+    labels.reset(table);
+  } else {
+    if (_path_to_voc_names.empty()) {
+      files.reset(new LabelFolder(_path_to_config_folder + '/'));
+    } else {
+      files.reset(
+          new VocFolder(_path_to_config_folder + '/', _path_to_voc_names));
+    }
+
+    if (_path_to_label_cache.empty()) {
+      labels = std::move(files);
+    } else {
+      std::vector<std::string> stems;
+      stems.reserve(n);
+      for (const auto &img_name : imgs_files) {
+        stems.push_back(img_name.substr(0, img_name.find_last_of('.')));
+      }
+      LabelCache *cache = new LabelCache(_path_to_label_cache, *files, stems);
+      log(std::string("label cache ") +
+              (cache->compiled() ? "compiled" : "up to date") + '\n',
+          LogLevel::info);
+      labels.reset(cache);
+    }
+  }
+  p_args.labels = labels.get();
 
   if (_path_to_background_image.empty()) {
     // if no background image is provided, use a blank image
@@ -610,47 +1044,252 @@ int App::run() {
     p_args.background_image = new Image(_path_to_background_image);
   }
 
-  // process each image one at a time (in parallel)
-  for (const auto &img_name : imgs_files) {
-    std::string img_name_no_ext =
-        img_name.substr(0, img_name.find_last_of('.'));
-
-    // some image specific parameters
-
-    p_args.img_num = idx;
-
-    p_args.img_name = img_name_no_ext;
-    p_args.img_path = _path_to_input_folder + '/' + img_name;
-    p_args.cfg_path = _path_to_config_folder + '/';
-
-    futures[idx++] = /* register future trait */
-        tp.push(std::move([p_args](ssize_t) { return process(p_args); }));
+  // the images go through the stages of a pipeline, each with its own
+  // workers, so that the file accesses do not hold up the codecs
+  const auto t0 = std::chrono::steady_clock::now();
+  const int channel_force = // force channel to be set to this value
+      p_args.background_image == nullptr ? 0
+                                         : p_args.background_image->channels();
+  const ImageType out_type = get_img_type(_image_ext);
+
+  // a dry run only prepares the images, on all the threads
+  Stage reader("read",
+               _dry_run ? static_cast<int>(_max_threads) : _read_threads),
+      decoder("decode", _decode_threads),
+      cropper("crop", _crop_threads), encoder("encode", _encode_threads),
+      writer("write", _write_threads);
+
+  // the decoded images are admitted against the memory budget, and hold
+  // their share of it until their last crop is encoded
+  MemoryBudget budget(_mem_budget);
+
+  // the crops go back to the crop stage once encoded, to reuse their buffers
+  Spares spares;
+
+  // the target is checked for every crop, the images not decoded yet are
+  // skipped once it is reached
+  CancelToken token;
+  CropQuota quota(_min_target_images, token);
+  std::atomic<unsigned> abandoned(0); // images left out by the target
+
+  // each queue holds a couple of items per worker of the next stage
+  BoundedQueue<unsigned> todo(n);
+  BoundedQueue<std::shared_ptr<ImageJob>> loaded(2 * decoder.workers());
+  BoundedQueue<CropBatch> decoded(2 * cropper.workers());
+  BoundedQueue<std::unique_ptr<CropJob>> cropped(2 * encoder.workers());
+  BoundedQueue<std::unique_ptr<CropJob>> encoded(2 * writer.workers());
+
+  unsigned long long unused = 0;
+  for (unsigned k = 0; k < n; k++) {
+    todo.push(std::move(k), unused);
+  }
+  todo.close();
+
+  // the workers of all the stages run at once, each on a thread of the pool
+  ThreadPool pool(reader.workers() +
+                  (_dry_run ? 0
+                            : decoder.workers() + cropper.workers() +
+                                  encoder.workers() + writer.workers()));
+  _report.prepared.assign(reader.workers(), 0);
+
+  reader.start(
+      pool, todo,
+      [&](unsigned &k, int id) {
+        if (token.cancelled()) {
+          abandoned++;
+          unsigned long long never = 0;
+          completed.push(Completion{k, 0}, never);
+          return;
+        }
+        std::shared_ptr<ImageJob> job = prepare(p_args, k, imgs_files[k]);
+        _report.prepared[id]++; // each worker has its own count
+        if (_dry_run || job->crops.empty()) {
+          finish(p_args, *job, completed);
+        } else {
+          reader.emit(loaded, std::move(job));
+        }
+      },
+      [&loaded]() { loaded.close(); });
+
+  // the other stages have nothing to do in a dry run
+  if (!_dry_run) {
+    decoder.start(
+        pool, loaded,
+        [&](std::shared_ptr<ImageJob> &job, int) {
+          if (token.cancelled()) {
+            abandoned++;
+            finish(p_args, *job, completed);
+            return;
+          }
+
+          const size_t size = job->decoded_size;
+          unsigned long long waited = 0;
+          if (budget.acquire(size, waited)) {
+            log("image '" + job->path + "' is larger than the memory budget\n",
+                LogLevel::warning);
+          }
+          decoder.blocked_for(waited);
+          if (token.cancelled()) { // while waiting for the budget
+            budget.release(size);
+            abandoned++;
+            finish(p_args, *job, completed);
+            return;
+          }
+
+          Image source;
+          if (!source.decode(job->bytes.data(), job->bytes.size(),
+                             channel_force)) {
+            panic("failed to read image from " + job->path);
+          }
+          std::vector<unsigned char>().swap(job->bytes);
+          job->pending = job->crops.size();
+          stats.decoded++;
+
+          // shared by the batches, and by the crops viewing it until they are
+          // encoded
+          std::shared_ptr<const Image> shared(
+              new Image(std::move(source)),
+              [&budget, size](const Image *image) {
+                delete image;
+                budget.release(size);
+              });
+          const std::vector<size_t> bounds =
+              batches(job->crops, cropper.workers());
+          for (size_t b = 0; b + 1 < bounds.size(); b++) {
+            CropBatch batch = {job, shared, bounds[b], bounds[b + 1]};
+            decoder.emit(decoded, std::move(batch));
+          }
+        },
+        [&decoded]() { decoded.close(); });
+
+    cropper.start(
+        pool, decoded,
+        [&](CropBatch &batch, int) {
+          const std::vector<Crop> &crops = batch.image->crops;
+          for (size_t k = batch.begin; k < batch.end; k++) {
+            if (!quota.claim(batch.image->num)) {
+              skip(p_args, *batch.image, batch.end - k, completed);
+              break;
+            }
+            std::unique_ptr<CropJob> cj(new CropJob());
+            cj->image = batch.image;
+            cj->k = k;
+            if (crops[k].inside) {
+              // nothing to compose, the source is encoded in place
+              cj->source = batch.source;
+            } else {
+              cj->subject = spares.take();
+              compose(p_args, *batch.source, crops[k], cj->subject);
+            }
+            cropper.emit(cropped, std::move(cj));
+          }
+        },
+        [&cropped]() { cropped.close(); });
+
+    encoder.start(
+        pool, cropped,
+        [&](std::unique_ptr<CropJob> &cj, int) {
+          const Crop &c = cj->image->crops[cj->k];
+          const bool encoded_ok =
+              cj->source
+                  ? cj->source->view(c.x, c.y, c.shape_width, c.shape_height)
+                        .encode(out_type, cj->bytes)
+                  : ImageView(cj->subject).encode(out_type, cj->bytes);
+          cj->source.reset();
+          spares.give(std::move(cj->subject));
+          if (!encoded_ok) {
+            done(p_args, *cj, false, completed);
+          } else {
+            encoder.emit(encoded, std::move(cj));
+          }
+        },
+        [&encoded]() { encoded.close(); });
+
+    writer.start(
+        pool, encoded,
+        [&](std::unique_ptr<CropJob> &cj, int) {
+          const bool written =
+              write_file(crop_path(p_args, *cj->image, cj->k), cj->bytes);
+          done(p_args, *cj, written, completed);
+        },
+        []() {});
   }
 
-  // wait for all threads to finish
+  // wait for all images to finish
 
-  idx = 0; // don't forget to reset the index
   volatile unsigned progress = 0, last_progress = 0;
   const std::string desc = "Cutting Images" FG_WHT " \u2702 " RST;
-  const std::string more = '[' + std::to_string(tp.size()) + ']';
+  std::stringstream workers;
+  workers << '[' << reader.workers();
+  if (!_dry_run) {
+    workers << '/' << decoder.workers() << '/' << cropper.workers() << '/'
+            << encoder.workers() << '/' << writer.workers();
+  }
+  workers << ']';
 
+  // the images are counted as they complete, a slow one does not hold the
+  // others back
   volatile ssize_t count = 0;              // number of images processed
   const ssize_t trgt = _min_target_images; // target number of images
-  for (auto &f : futures) {
-    count += f.get();
-    if (trgt != EOF && count > 0 && count >= trgt) break;
+  Completion c;
+  while (idx < n && completed.pop(c, unused)) {
+    idx++;
+    count += c.images;
+    _report.order.push_back(c.num);
+    if (trgt != EOF && count > 0 && count >= trgt) {
+      token.cancel(); // the dry runs do not claim any crop
+      break;
+    }
 
-    progress = (++idx * 100) / n;
+    progress = (idx * 100) / n;
     if (progress > last_progress) {
-      display_progress(idx, n, desc, more); // need to add endl after
+      // how fast the images are generated so far
+      const double elapsed = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - t0)
+                                 .count();
+      std::stringstream more;
+      more << workers.str() << ' ' << std::fixed << std::setprecision(1)
+           << (elapsed > 0 ? count / elapsed : 0.0) << " img/s";
+      display_progress(idx, n, desc, more.str()); // need to add endl after
       last_progress = progress; // only update if progress has changed
     }
   }
 
   std::cout << std::endl;
 
-  // terminate the thread pool
-  tp.stop(false);
+  // once the target is reached, the workers skip the work left and leave
+  // after the last image went through
+  reader.join();
+  decoder.join();
+  cropper.join();
+  encoder.join();
+  writer.join();
+  pool.stop(true);
+
+  // the images that completed after the target was reached, if any
+  completed.close();
+  while (completed.pop(c, unused)) {
+    count += c.images;
+    _report.order.push_back(c.num);
+  }
+
+  if (_mem_budget > 0 && !_dry_run) {
+    std::stringstream ss;
+    ss << "decoded images peaked at " << std::fixed << std::setprecision(1)
+       << budget.peak() / 1048576.0 << " MiB of a " << _mem_budget / 1048576.0
+       << " MiB budget\n";
+    log(ss.str(), LogLevel::info);
+  }
+
+  // how busy each stage was, to size them
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - t0)
+                             .count();
+  if (!_dry_run) {
+    for (const Stage *s : {&reader, &decoder, &cropper, &encoder, &writer}) {
+      log(s->report(seconds) + '\n', LogLevel::info);
+    }
+  }
 
   // delete the background image if it was created
   if (p_args.background_image != nullptr) {
@@ -659,24 +1298,80 @@ int App::run() {
 
   // figure out if we need a 's' at "image(s)"
   const char sc = count > 1l ? 's' : ' ';
-  log("created " + std::to_string(count) + " image" + sc + '\n',
+  log((_dry_run ? "would create " : "created ") + std::to_string(count) +
+          " image" + sc + '\n',
       LogLevel::info);
+  if (_dry_run) print_summary(stats.summary, n);
+
+  // how many images were not decoded because none of their objects survived
+  const unsigned skipped = stats.skipped;
+  if (!_dry_run) {
+    log("skipped " + std::to_string(skipped) + " decode" +
+            (skipped > 1u ? 's' : ' ') + " out of " +
+            std::to_string(stats.decoded + skipped) + '\n',
+        LogLevel::info);
+  }
+
+  if (_nms_iou >= 0) {
+    log("suppressed " + std::to_string(stats.suppressed) +
+            " overlapping object(s)\n",
+        LogLevel::info);
+  }
+
+  // objects dropped because their class is not in the names file, whether
+  // they were read from the files or from the cache
+  if (labels->dropped() > 0) {
+    log(std::to_string(labels->dropped()) +
+            " object(s) with a class missing from the names file\n",
+        LogLevel::warning);
+  }
+
+  // how effective the mask cache was on the shaped crops
+  if (!_dry_run && (_image_shape == ImageShape::circle ||
+                    _image_shape == ImageShape::ellipse)) {
+    const MaskCache &cache = MaskCache::instance();
+    log("mask cache: " + std::to_string(cache.hits()) + " hit(s), " +
+            std::to_string(cache.misses()) + " miss(es)\n",
+        LogLevel::info);
+  }
+
+  if (abandoned > 0) {
+    log("target reached, " + std::to_string(abandoned) +
+            " image(s) left unprocessed\n",
+        LogLevel::info);
+  }
 
   // if the number of generated images is less than the target number
   if (count < trgt) {
     log("could not create enough images\n", LogLevel::warning);
   }
 
+  _report.images = n;
+  _report.unprocessed = abandoned;
+  _report.processed = n - _report.unprocessed;
+  _report.created = count;
+  _report.summary = stats.summary;
+
   return EXIT_SUCCESS;
 }
 
+const RunReport &App::report() const { return _report; }
+
 std::ostream &operator<<(std::ostream &os, const App &app) {
   os << "App..." << '\n'
      << "path to input folder: " << app._path_to_input_folder << '\n'
      << "path to config folder: " << app._path_to_config_folder << '\n'
+     << "path to label index: " << app._path_to_label_index << '\n'
+     << "path to label cache: " << app._path_to_label_cache << '\n'
+     << "path to COCO file: " << app._path_to_coco_file << '\n'
+     << "path to VOC names file: " << app._path_to_voc_names << '\n'
      << "path to output folder: " << app._path_to_output_folder << '\n'
      << "image extension: " << app._image_ext << '\n'
-     << "maximum threads to use for processing: " << app._max_threads << '\n'
+     << "threads shared by the stages: " << app._max_threads << '\n'
+     << "memory budget: " << app._mem_budget << '\n'
+     << "stage workers: " << app._read_threads << ", " << app._decode_threads
+     << ", " << app._crop_threads << ", " << app._encode_threads << ", "
+     << app._write_threads << '\n'
      << "minimum object size: " << app._min_object_size << '\n'
      << "maximum object size: " << app._max_object_size << '\n'
      << "target width: " << app._target_width << '\n'
@@ -688,7 +1383,9 @@ std::ostream &operator<<(std::ostream &os, const App &app) {
      << "path to background image: " << app._path_to_background_image << '\n'
      << "selected class id: " << app._class_id << '\n'
      << "minimum confidence score: " << app._min_confidence << '\n'
-     << "target minimum number of images: " << app._min_target_images << '\n';
+     << "non maximum suppression IoU: " << app._nms_iou << '\n'
+     << "target minimum number of images: " << app._min_target_images << '\n'
+     << "dry run: " << app._dry_run << '\n';
 
   return os;
 }
@@ -0,0 +1,332 @@
+#include "coco.h"
+
+/**
+ * @brief pull reader over a JSON document, the caller walks the values it
+ * needs and skips the others
+ * @note the reader is lenient about commas, it is not a validator
+ *
+ */
+class JsonReader {
+private:
+  const char *_p;
+  const char *const _begin;
+  const char *const _end;
+  const std::string &_path;
+
+  void fail [[noreturn]] (const char *what) const {
+    panic("malformed COCO file '" + _path + "' at byte " +
+          std::to_string(_p - _begin) + " (expected " + what + ')');
+  }
+
+  void blank() {
+    while (_p != _end &&
+           (*_p == ' ' || *_p == '\n' || *_p == '\r' || *_p == '\t'))
+      _p++;
+  }
+
+  /// @brief append the UTF-8 encoding of a code point
+  static void utf8(std::string &out, const unsigned cp) {
+    if (cp < 0x80) {
+      out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+      out += static_cast<char>(0xc0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+      out += static_cast<char>(0xe0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+      out += static_cast<char>(0xf0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+
+  unsigned hex4() {
+    if (_end - _p < 4) fail("\\u and 4 hexadecimal digits");
+    unsigned cp = 0;
+    for (int k = 0; k < 4; k++, _p++) {
+      const char c = *_p;
+      cp <<= 4;
+      if (c >= '0' && c <= '9') {
+        cp |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        cp |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        cp |= c - 'A' + 10;
+      } else {
+        fail("an hexadecimal digit");
+      }
+    }
+    return cp;
+  }
+
+public:
+  JsonReader(const char *data, const size_t size, const std::string &path)
+      : _p(data), _begin(data), _end(data + size), _path(path) {}
+
+  /// @brief enter an object ('{') or an array ('[')
+  void open(const char c) {
+    blank();
+    if (_p == _end || *_p != c) fail(c == '{' ? "'{'" : "'['");
+    _p++;
+  }
+
+  /// @brief whether the current object or array has another value
+  bool more(const char close) {
+    blank();
+    if (_p == _end) fail("a value or the end of a container");
+    if (*_p == close) {
+      _p++;
+      return false;
+    }
+    if (*_p == ',') _p++;
+    return true;
+  }
+
+  /// @brief the key of the next member of an object
+  std::string key() {
+    std::string k = string();
+    blank();
+    if (_p == _end || *_p != ':') fail("':'");
+    _p++;
+    return k;
+  }
+
+  std::string string() {
+    blank();
+    if (_p == _end || *_p != '"') fail("a string");
+    std::string out;
+    for (_p++; _p != _end && *_p != '"'; _p++) {
+      if (*_p != '\\') {
+        out += *_p;
+        continue;
+      }
+      if (++_p == _end) break;
+      switch (*_p) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        _p++;
+        unsigned cp = hex4();
+        if (cp >= 0xd800 && cp < 0xdc00 && _end - _p >= 2 && _p[0] == '\\' &&
+            _p[1] == 'u') { // surrogate pair
+          _p += 2;
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (hex4() - 0xdc00);
+        }
+        utf8(out, cp);
+        _p--; // the loop steps over the last digit
+        break;
+      }
+      default: // '"', '\\' and '/'
+        out += *_p;
+        break;
+      }
+    }
+    if (_p == _end) fail("the end of a string");
+    _p++;
+    return out;
+  }
+
+  double number() {
+    blank();
+    char buffer[64];
+    size_t n = 0;
+    auto numeric = [this]() {
+      return _p != _end &&
+             ((*_p >= '0' && *_p <= '9') || *_p == '-' || *_p == '+' ||
+              *_p == '.' || *_p == 'e' || *_p == 'E');
+    };
+    while (n < sizeof(buffer) - 1 && numeric())
+      buffer[n++] = *_p++;
+    if (numeric()) fail("a number of at most 63 characters");
+    buffer[n] = '\0';
+
+    char *last;
+    const double value = strtod(buffer, &last);
+    if (n == 0 || last != buffer + n) fail("a number");
+    return value;
+  }
+
+  /// @brief step over a value of any type
+  void skip() {
+    blank();
+    if (_p == _end) fail("a value");
+    switch (*_p) {
+    case '"':
+      string();
+      return;
+    case '{':
+    case '[':
+      break;
+    case 't':
+    case 'f':
+    case 'n':
+      while (_p != _end && ((*_p >= 'a' && *_p <= 'z') ||
+                            (*_p >= 'A' && *_p <= 'Z')))
+        _p++;
+      return;
+    default:
+      number();
+      return;
+    }
+
+    // a container, only its depth matters
+    size_t depth = 0;
+    do {
+      switch (*_p) {
+      case '"':
+        for (_p++; _p != _end && *_p != '"'; _p++) {
+          if (*_p == '\\' && _p + 1 != _end) _p++;
+        }
+        if (_p == _end) fail("the end of a string");
+        break;
+      case '{':
+      case '[':
+        depth++;
+        break;
+      case '}':
+      case ']':
+        depth--;
+        break;
+      }
+      _p++;
+    } while (depth > 0 && _p != _end);
+    if (depth > 0) fail("the end of a container");
+  }
+};
+
+CocoIndex::CocoIndex(const std::string &path) : LabelTable(path) {
+  const MappedFile file(path);
+  if (!file.is_open()) {
+    panic("could not open COCO file '" + path + (char)047);
+  }
+  if (file.size() > 0) { // read once, from start to end
+    madvise(const_cast<char *>(file.data()), file.size(), MADV_SEQUENTIAL);
+  }
+
+  struct Picture {
+    std::string stem;
+    double width = 0, height = 0;
+  };
+  std::unordered_map<long long, Picture> pictures;
+
+  // the annotations of the images not read yet, by image id, with their
+  // absolute top-left corner and size until the images are known
+  std::unordered_map<long long, std::vector<Box>> pending;
+
+  auto sized = [](const Picture &picture) {
+    return picture.width > 0 && picture.height > 0;
+  };
+  // the center and size of an absolute box, relative to its image
+  auto normalize = [](const Picture &picture, Box &box) {
+    box.cx = (box.cx + box.w / 2) / picture.width;
+    box.cy = (box.cy + box.h / 2) / picture.height;
+    box.w /= picture.width;
+    box.h /= picture.height;
+  };
+
+  JsonReader json(file.data(), file.size(), path);
+  json.open('{');
+  while (json.more('}')) {
+    const std::string section = json.key();
+
+    if (section == "images") {
+      json.open('[');
+      while (json.more(']')) {
+        long long id = EOF;
+        Picture picture;
+        json.open('{');
+        while (json.more('}')) {
+          const std::string k = json.key();
+          if (k == "id") {
+            id = static_cast<long long>(json.number());
+          } else if (k == "file_name") {
+            const std::string name = json.string();
+            picture.stem = image_stem(name.data(), name.data() + name.size());
+          } else if (k == "width") {
+            picture.width = json.number();
+          } else if (k == "height") {
+            picture.height = json.number();
+          } else {
+            json.skip();
+          }
+        }
+        pictures[id] = picture;
+      }
+    } else if (section == "annotations") {
+      json.open('[');
+      while (json.more(']')) {
+        long long image = EOF;
+        Box box = Box();
+        box.score = 1.0; // ground truth, without a score
+        json.open('{');
+        while (json.more('}')) {
+          const std::string k = json.key();
+          if (k == "image_id") {
+            image = static_cast<long long>(json.number());
+          } else if (k == "category_id") {
+            box.cls = static_cast<int>(json.number());
+          } else if (k == "score") {
+            box.score = json.number();
+          } else if (k == "bbox") {
+            double *const xywh[] = {&box.cx, &box.cy, &box.w, &box.h};
+            int n = 0;
+            json.open('[');
+            for (; json.more(']'); n++) {
+              if (n < 4) {
+                *xywh[n] = json.number();
+              } else {
+                json.skip();
+              }
+            }
+          } else {
+            json.skip();
+          }
+        }
+
+        // straight to the table once the image is known
+        const auto it = pictures.find(image);
+        if (it == pictures.end()) {
+          pending[image].push_back(box);
+        } else if (sized(it->second)) {
+          normalize(it->second, box);
+          add(it->second.stem, box);
+        } else {
+          _orphans++;
+        }
+      }
+    } else {
+      json.skip(); // info, licenses, categories...
+    }
+  }
+
+  // the annotations that came before their image, moved to the table
+  for (auto &annotations : pending) {
+    const auto it = pictures.find(annotations.first);
+    std::vector<Box> &boxes = annotations.second;
+    if (it == pictures.end() || !sized(it->second)) {
+      _orphans += boxes.size();
+      continue;
+    }
+    for (Box &box : boxes)
+      normalize(it->second, box);
+    add(it->second.stem, std::move(boxes));
+  }
+}
+
+size_t CocoIndex::orphans() const { return _orphans; }
@@ -1,10 +1,124 @@
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include "kernels.h"
 
-#include "image.h"
+MaskCache::MaskCache() : _hits(0), _misses(0) {}
+
+MaskCache &MaskCache::instance() {
+  static MaskCache cache; // thread-safe initialization
+  return cache;
+}
+
+/// @brief compute the row spans of an ellipse, centered on (width/2, height/2)
+static std::shared_ptr<const Spans> ellipse_spans(int width, int height) {
+  std::shared_ptr<Spans> spans = std::make_shared<Spans>(height);
+
+  const float cx = width / 2.0f;
+  const float cy = height / 2.0f;
+  const float rx = static_cast<float>(width) / 2.0f;
+  const float ry = static_cast<float>(height) / 2.0f;
+
+  // the pixel test of the mask, the spans below are checked against it so
+  // that the result is exactly the same as testing every pixel
+  auto inside = [&](const float dy2, const int j) {
+    const float dx = static_cast<float>(j) - cx;
+    return dx * dx / (rx * rx) + dy2 <= 1;
+  };
+
+  const int jm = width / 2; // the column closest to the center
+
+  for (int i = 0; i < height; i++) {
+    const float dy = static_cast<float>(i) - cy;
+    const float dy2 = dy * dy / (ry * ry);
+    if (width <= 0 || !inside(dy2, jm)) {
+      (*spans)[i] = std::make_pair(0, 0); // the row does not cross the ellipse
+      continue;
+    }
+
+    // the analytic extent of the row, then fixed up with the pixel test
+    const float t = std::sqrt(std::max(0.0f, 1.0f - dy2)) * rx;
+    int jl = std::min(jm, std::max(0, static_cast<int>(std::ceil(rx - t))));
+    int jr = std::max(jm + 1, std::min(width, static_cast<int>(rx + t) + 1));
+    while (jl > 0 && inside(dy2, jl - 1))
+      jl--;
+    while (!inside(dy2, jl))
+      jl++;
+    while (jr < width && inside(dy2, jr))
+      jr++;
+    while (!inside(dy2, jr - 1))
+      jr--;
+
+    (*spans)[i] = std::make_pair(jl, jr);
+  }
+
+  return spans;
+}
+
+std::shared_ptr<const Spans> MaskCache::ellipse(int width, int height) {
+  const std::pair<int, int> key = std::make_pair(width, height);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _ellipses.find(key);
+    if (it != _ellipses.end()) {
+      _hits++;
+      return it->second;
+    }
+  }
+  _misses++;
+
+  // computed outside of the lock, another thread might do the same
+  std::shared_ptr<const Spans> spans = ellipse_spans(width, height);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_ellipses.size() < capacity) _ellipses.emplace(key, spans);
+  return spans;
+}
+
+unsigned long MaskCache::hits() const { return _hits; }
+unsigned long MaskCache::misses() const { return _misses; }
+
+const size_t BufferPool::alignment;
+const size_t BufferPool::capacity;
+
+BufferPool::~BufferPool() {
+  for (const auto &buffer : _idle)
+    free(buffer.second);
+}
+
+BufferPool &BufferPool::local() {
+  static thread_local BufferPool pool;
+  return pool;
+}
+
+unsigned char *BufferPool::acquire(size_t size, size_t &capacity) {
+  // the smallest idle buffer that is large enough
+  auto best = _idle.end();
+  for (auto it = _idle.begin(); it != _idle.end(); ++it) {
+    if (it->first >= size && (best == _idle.end() || it->first < best->first))
+      best = it;
+  }
+  if (best != _idle.end()) {
+    unsigned char *data = best->second;
+    capacity = best->first;
+    _idle.erase(best);
+    return data;
+  }
+
+  void *data = nullptr;
+  capacity = std::max(alignment, (size + alignment - 1) / alignment * alignment);
+  if (posix_memalign(&data, alignment, capacity) != 0) {
+    panic("failed to allocate memory for image");
+  }
+  return static_cast<unsigned char *>(data);
+}
+
+void BufferPool::release(unsigned char *data, size_t capacity) {
+  if (_idle.size() < BufferPool::capacity) {
+    _idle.emplace_back(capacity, data);
+  } else {
+    free(data);
+  }
+}
 
 Image::Image() {
   _width = 0;
@@ -29,14 +143,59 @@ Image::Image(int width, int height, int channels)
   chk_p(memset(_data, (unsigned char)0, _size));
 }
 
+Image::Image(int width, int height, int channels, BufferPool &pool)
+    : _width(width), _height(height), _channels(channels) {
+  _size = static_cast<size_t>(_width) * _height * _channels;
+  _data = pool.acquire(_size, _capacity);
+}
+
 Image::Image(const Image &other)
     : Image(other._width, other._height, other._channels) {
   void *dest = memcpy(_data, other._data, _size);
   if (dest != _data) panic("failed to copy image");
 }
 
+Image::Image(Image &&other) noexcept
+    : _width(other._width), _height(other._height), _channels(other._channels),
+      _size(other._size), _data(other._data), _capacity(other._capacity) {
+  other._width = other._height = other._channels = 0;
+  other._size = other._capacity = 0;
+  other._data = nullptr;
+}
+
+Image &Image::operator=(const Image &other) {
+  if (this != &other) *this = Image(other);
+  return *this;
+}
+
+Image &Image::operator=(Image &&other) noexcept {
+  std::swap(_width, other._width);
+  std::swap(_height, other._height);
+  std::swap(_channels, other._channels);
+  std::swap(_size, other._size);
+  std::swap(_data, other._data);
+  std::swap(_capacity, other._capacity);
+  return *this; // the previous buffer is released along with other
+}
+
+void Image::reshape(int width, int height, int channels) {
+  const size_t size = static_cast<size_t>(width) * height * channels;
+  if (_data == nullptr || _capacity < size) {
+    *this = Image(width, height, channels, BufferPool::local());
+    return;
+  }
+  _width = width;
+  _height = height;
+  _channels = channels;
+  _size = size;
+}
+
 Image::~Image() {
-  if (_data != nullptr) stbi_image_free(_data);
+  if (_data != nullptr && _capacity > 0) {
+    BufferPool::local().release(_data, _capacity);
+  } else if (_data != nullptr) {
+    kernels().free(_data);
+  }
 }
 
 const int &Image::width() const { return _width; }
@@ -59,109 +218,250 @@ const unsigned char *Image::data() const { return _data; }
 unsigned char *Image::data() { return _data; }
 void Image::data(const unsigned char *data) { memcpy(_data, data, _size); }
 
+bool Image::probe(const std::string &path, int &width, int &height,
+                  int &channels) {
+  return kernels().info(path.c_str(), &width, &height, &channels) != 0;
+}
+
 bool Image::read(const std::string &path, int channels_force) {
-  _data =
-      stbi_load(path.c_str(), &_width, &_height, &_channels, channels_force);
+  _data = kernels().load(path.c_str(), &_width, &_height, &_channels,
+                         channels_force);
+  channels() = channels_force == 0 ? channels() : channels_force;
+  _size = data() == nullptr
+              ? 0
+              : static_cast<size_t>(_width) * _height * _channels;
+  return data() != nullptr;
+}
+
+bool Image::probe(const unsigned char *bytes, const size_t size, int &width,
+                  int &height, int &channels) {
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return false; // stb takes an int
+  }
+  return kernels().info_memory(bytes, static_cast<int>(size), &width, &height,
+                               &channels) != 0;
+}
+
+bool Image::decode(const unsigned char *bytes, const size_t size,
+                   int channels_force) {
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return false;
+  }
+  _data = kernels().load_memory(bytes, static_cast<int>(size), &_width,
+                                &_height, &_channels, channels_force);
   channels() = channels_force == 0 ? channels() : channels_force;
+  _size = data() == nullptr
+              ? 0
+              : static_cast<size_t>(_width) * _height * _channels;
   return data() != nullptr;
 }
 
 bool Image::write(const std::string &path) const {
-  bool success;
+  return ImageView(*this).write(path);
+}
+
+ImageView Image::view(int x, int y, int width, int height) const {
+  if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > _width ||
+      y + height > _height) {
+    panic("view out of the image bounds");
+  }
+  const size_t stride = static_cast<size_t>(_width) * _channels;
+  return ImageView(_data + y * stride + static_cast<size_t>(x) * _channels,
+                   width, height, _channels, stride);
+}
+
+ImageView::ImageView(const unsigned char *data, int width, int height,
+                     int channels, size_t stride)
+    : _data(data), _width(width), _height(height), _channels(channels),
+      _stride(stride) {}
+
+ImageView::ImageView(const Image &image)
+    : ImageView(image.data(), image.width(), image.height(), image.channels(),
+                static_cast<size_t>(image.width()) * image.channels()) {}
+
+int ImageView::width() const { return _width; }
+int ImageView::height() const { return _height; }
+int ImageView::channels() const { return _channels; }
+size_t ImageView::stride() const { return _stride; }
+const unsigned char *ImageView::data() const { return _data; }
+
+bool ImageView::write(const std::string &path) const {
   const ImageType type = get_img_type(path);
+  if (type == ImageType::unknown) {
+    log("unknown image type from " + path + " - image not saved\n",
+        LogLevel::error);
+    return false;
+  }
+
+  std::vector<unsigned char> bytes;
+  return encode(type, bytes) && write_file(path, bytes);
+}
+
+// appends the bytes of the encoders to a vector
+static void append_bytes(void *context, void *data, int size) {
+  std::vector<unsigned char> &bytes =
+      *static_cast<std::vector<unsigned char> *>(context);
+  const unsigned char *begin = static_cast<const unsigned char *>(data);
+  bytes.insert(bytes.end(), begin, begin + size);
+}
 
+bool ImageView::encode(const ImageType type,
+                       std::vector<unsigned char> &bytes) const {
+  bool success;
+  const size_t row = static_cast<size_t>(_width) * _channels;
+
+  // only the png encoder takes a stride, the others need contiguous rows
+  if (type != ImageType::png && type != ImageType::unknown && _stride != row) {
+    Image packed = Image(_width, _height, _channels);
+    for (int i = 0; i < _height; i++) {
+      chk_p(memcpy(packed.data() + i * row, _data + i * _stride, row));
+    }
+    return ImageView(packed).encode(type, bytes);
+  }
+
+  bytes.clear();
   switch (type) {
   case ImageType::png:
-    success = stbi_write_png(path.c_str(), width(), height(), channels(),
-                             data(), width() * channels());
+    success = kernels().encode_png(append_bytes, &bytes, _width, _height,
+                                   _channels, _data, static_cast<int>(_stride));
     break;
   case ImageType::jpg:
-    success = stbi_write_jpg(path.c_str(), width(), height(), channels(),
-                             data(), 100);
+    success = kernels().encode_jpg(append_bytes, &bytes, _width, _height,
+                                   _channels, _data, 100);
     break;
   case ImageType::bmp:
-    success =
-        stbi_write_bmp(path.c_str(), width(), height(), channels(), data());
+    success = kernels().encode_bmp(append_bytes, &bytes, _width, _height,
+                                   _channels, _data);
     break;
   default:
-    log("unknown image type from " + path + " - image not saved\n",
-        LogLevel::error);
     success = false;
     break;
   }
   return success;
 }
 
-Image *Image::crop_rect(int x, int y, int width, int height, Image *bg, int bw,
-                        int bh) const {
-  const int cw = bw == EOF ? width : bw;
-  const int ch = bh == EOF ? height : bh;
-  Image *cropped;
-  if (bg == nullptr) {
-    cropped = new Image(cw, ch, channels());
-  } else {
-    cropped = bg;
-  }
-
-  const int w = cropped->width();
-  const int h = cropped->height();
+template <int C>
+void Image::compose_n(Image &cropped, int x, int y, int width, int height,
+                      const Image *bg, const Spans *spans) const {
+  const int c = C > 0 ? C : channels(); // constant folded when specialized
+  const int w = cropped.width();
+  const int h = cropped.height();
   const int x0 = w / 2 - width / 2;
   const int y0 = h / 2 - height / 2;
 
-  // log("cropping image to " + std::to_string(width) + "x" +
-  //         std::to_string(height) + " at " + std::to_string(x) + "x" +
-  //         std::to_string(y) + " with background " + std::to_string(w) + "x" +
-  //         std::to_string(h) + " at " + std::to_string(x0) + "x" +
-  //         std::to_string(y0) + "\n",
-  //     LogLevel::debug);
+  // clip the rows and columns once, against both the source and the
+  // destination, so that every row is a single contiguous copy
+  const int i0 = std::max({0, -y, -y0});
+  const int i1 = std::min({height, _height - y, h - y0});
+  const int j0 = std::max({0, -x, -x0});
+  const int j1 = std::min({width, _width - x, w - x0});
 
-  for (int i = 0; i < height; i++) {
-    if (i + y >= _height || i + y < 0) continue;
-    for (int j = 0; j < width; j++) {
-      if (j + x >= _width || j + x < 0) continue;
-      chk_p(memcpy(cropped->data() + ((y0 + i) * w + x0 + j) * channels(),
-                   data() + ((y + i) * _width + x + j) * channels(),
-                   channels()));
+  // the background is cropped at its center, to the size of the new image
+  const int bx = bg == nullptr ? 0 : bg->width() / 2 - w / 2;
+  const int by = bg == nullptr ? 0 : bg->height() / 2 - h / 2;
+  const int b0 = bg == nullptr ? 0 : std::max(0, -bx);
+  const int b1 = bg == nullptr ? 0 : std::min(w, bg->width() - bx);
+
+  // fill row r between columns [a, b) with the background, and with zeros
+  // where there is none (the buffer is not cleared beforehand)
+  auto background = [&](unsigned char *row, const int r, int a, int b) {
+    if (a >= b) return;
+    int ba = a, bb = a; // the columns covered by the background image
+    if (bg != nullptr && by + r >= 0 && by + r < bg->height()) {
+      ba = std::max(a, b0);
+      bb = std::min(b, b1);
+      if (ba < bb) {
+        chk_p(memcpy(row + static_cast<size_t>(ba) * c,
+                     bg->data() + (static_cast<size_t>(by + r) * bg->width() +
+                                   bx + ba) * c,
+                     static_cast<size_t>(bb - ba) * c));
+      } else {
+        ba = bb = a;
+      }
+    }
+    if (a < ba) memset(row + static_cast<size_t>(a) * c, 0, (ba - a) * c);
+    if (bb < b) memset(row + static_cast<size_t>(bb) * c, 0, (b - bb) * c);
+  };
+
+  for (int r = 0; r < h; r++) {
+    unsigned char *row = cropped.data() + static_cast<size_t>(r) * w * c;
+    int sa = 0, sb = 0; // the columns of the source on this row
+
+    const int i = r - y0;
+    if (i >= i0 && i < i1) {
+      // the part of the shape that is not clipped
+      const int jl = spans == nullptr ? j0 : std::max((*spans)[i].first, j0);
+      const int jr = spans == nullptr ? j1 : std::min((*spans)[i].second, j1);
+      if (jl < jr) {
+        sa = x0 + jl;
+        sb = x0 + jr;
+        chk_p(memcpy(row + static_cast<size_t>(sa) * c,
+                     data() + (static_cast<size_t>(y + i) * _width + x + jl) *
+                                  c,
+                     static_cast<size_t>(sb - sa) * c));
+      }
     }
+
+    // the background goes around the source, in the same pass
+    background(row, r, 0, sa);
+    background(row, r, sb, w);
   }
+}
 
-  return cropped;
+void Image::compose(Image &cropped, int x, int y, int width, int height,
+                    const Image *bg, const Spans *spans) const {
+  if (bg != nullptr && bg->channels() != channels()) {
+    panic("background image does not have the same number of channels");
+  }
+
+  // dispatch once per crop on the most common channel counts
+  switch (channels()) {
+  case 1:
+    compose_n<1>(cropped, x, y, width, height, bg, spans);
+    break;
+  case 3:
+    compose_n<3>(cropped, x, y, width, height, bg, spans);
+    break;
+  case 4:
+    compose_n<4>(cropped, x, y, width, height, bg, spans);
+    break;
+  default:
+    compose_n<0>(cropped, x, y, width, height, bg, spans);
+    break;
+  }
 }
 
-Image *Image::crop_ellipse(int x, int y, int width, int height, Image *bg,
-                           int bw, int bh) const {
+void Image::crop_rect(Image &cropped, int x, int y, int width, int height,
+                      const Image *bg, int bw, int bh) const {
   const int cw = bw == EOF ? width : bw;
   const int ch = bh == EOF ? height : bh;
-  Image *cropped;
-  if (bg == nullptr) {
-    cropped = new Image(cw, ch, channels());
-  } else {
-    cropped = bg;
-  }
+  cropped.reshape(cw, ch, channels());
 
-  const float cx = static_cast<float>(x) + width / 2.0f;
-  const float cy = static_cast<float>(y) + height / 2.0f;
-  const float rx = static_cast<float>(width) / 2.0f;
-  const float ry = static_cast<float>(height) / 2.0f;
+  compose(cropped, x, y, width, height, bg, nullptr);
+}
 
-  const int w = cropped->width();
-  const int h = cropped->height();
-  const int x0 = w / 2 - width / 2;
-  const int y0 = h / 2 - height / 2;
+Image Image::crop_rect(int x, int y, int width, int height, const Image *bg,
+                       int bw, int bh) const {
+  Image cropped;
+  crop_rect(cropped, x, y, width, height, bg, bw, bh);
+  return cropped;
+}
 
-  for (int i = 0; i < height; i++) {
-    if (i + y >= _height || i + y < 0) continue;
-    for (int j = 0; j < width; j++) {
-      if (j + x >= _width || j + x < 0) continue;
-      const float dx = static_cast<float>(j) + x - cx;
-      const float dy = static_cast<float>(i) + y - cy;
-      if (dx * dx / (rx * rx) + dy * dy / (ry * ry) <= 1) {
-        chk_p(memcpy(cropped->data() + ((y0 + i) * w + x0 + j) * channels(),
-                     data() + ((y + i) * _width + x + j) * channels(),
-                     channels()));
-      }
-    }
-  }
+void Image::crop_ellipse(Image &cropped, int x, int y, int width, int height,
+                         const Image *bg, int bw, int bh) const {
+  const int cw = bw == EOF ? width : bw;
+  const int ch = bh == EOF ? height : bh;
+  cropped.reshape(cw, ch, channels());
+
+  const std::shared_ptr<const Spans> spans =
+      MaskCache::instance().ellipse(width, height);
+
+  compose(cropped, x, y, width, height, bg, spans.get());
+}
 
+Image Image::crop_ellipse(int x, int y, int width, int height,
+                          const Image *bg, int bw, int bh) const {
+  Image cropped;
+  crop_ellipse(cropped, x, y, width, height, bg, bw, bh);
   return cropped;
 }
@@ -0,0 +1,31 @@
+// this file is compiled once per ISA level (see the Makefile), each time
+// with its own static copy of the stb codecs and KERNELS_ISA set accordingly
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "kernels.h"
+
+#ifndef KERNELS_ISA
+#define KERNELS_ISA generic
+#endif
+
+#define KERNELS_STR_(s) #s
+#define KERNELS_STR(s) KERNELS_STR_(s)
+#define KERNELS_CAT_(a, b) a##b
+#define KERNELS_CAT(a, b) KERNELS_CAT_(a, b)
+
+extern const Kernels KERNELS_CAT(kernels_, KERNELS_ISA);
+
+const Kernels KERNELS_CAT(kernels_, KERNELS_ISA) = {
+    KERNELS_STR(KERNELS_ISA), stbi_load,      stbi_info,
+    stbi_image_free,          stbi_write_png, stbi_write_jpg,
+    stbi_write_bmp,           stbi_load_from_memory,
+    stbi_info_from_memory,    stbi_write_png_to_func,
+    stbi_write_jpg_to_func,   stbi_write_bmp_to_func,
+};
@@ -0,0 +1,65 @@
+#include "kernels.h"
+
+// the ISA levels below must match the ones built by the Makefile
+
+#if defined(__x86_64__)
+
+extern const Kernels kernels_sse2;
+extern const Kernels kernels_sse4_2;
+extern const Kernels kernels_avx2;
+
+static const Kernels &select_kernels() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return kernels_avx2;
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+    return kernels_sse4_2;
+  }
+  return kernels_sse2;
+}
+
+const std::vector<const Kernels *> &kernels_built() {
+  static const std::vector<const Kernels *> built = {
+      &kernels_sse2, &kernels_sse4_2, &kernels_avx2};
+  return built;
+}
+
+#else
+
+extern const Kernels kernels_generic;
+
+static const Kernels &select_kernels() { return kernels_generic; }
+
+const std::vector<const Kernels *> &kernels_built() {
+  static const std::vector<const Kernels *> built = {&kernels_generic};
+  return built;
+}
+
+#endif
+
+const Kernels &kernels() {
+  static const Kernels &selected = select_kernels(); // thread-safe
+  return selected;
+}
+
+std::string kernels_info() {
+  std::stringstream ss;
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  ss << "cpu features:"
+     << " sse2" << (__builtin_cpu_supports("sse2") ? '+' : '-')
+     << " sse4.2" << (__builtin_cpu_supports("sse4.2") ? '+' : '-')
+     << " popcnt" << (__builtin_cpu_supports("popcnt") ? '+' : '-')
+     << " avx" << (__builtin_cpu_supports("avx") ? '+' : '-')
+     << " avx2" << (__builtin_cpu_supports("avx2") ? '+' : '-');
+  ss << '\n';
+#endif
+
+  ss << "built kernels:";
+  for (const Kernels *k : kernels_built()) {
+    ss << ' ' << k->isa;
+  }
+  ss << '\n' << "selected kernels: " << kernels().isa << '\n';
+
+  return ss.str();
+}
@@ -0,0 +1,648 @@
+#include "label.h"
+
+MappedFile::MappedFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    chk(close(fd));
+    return;
+  }
+
+  _size = static_cast<size_t>(st.st_size);
+  if (_size > 0) {
+    void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      _size = 0;
+      chk(close(fd));
+      return;
+    }
+    _data = static_cast<const char *>(data);
+  } // an empty file cannot be mapped, but is still a valid file
+
+  chk(close(fd)); // the mapping stays valid without the descriptor
+  _open = true;
+}
+
+MappedFile::~MappedFile() {
+  if (_data != nullptr) chk(munmap(const_cast<char *>(_data), _size));
+}
+
+bool MappedFile::is_open() const { return _open; }
+
+const char *MappedFile::data() const { return _data; }
+
+size_t MappedFile::size() const { return _size; }
+
+/// @brief isspace() in the "C" locale
+static inline bool is_space(const char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+
+/// @brief a token ends on a blank or at the end of the line
+static inline bool at_token_end(const char *p, const char *end) {
+  return p == end || is_space(*p);
+}
+
+/**
+ * @brief parse a short decimal integer, as %d would
+ *
+ * @return true - the token was parsed, p is moved past it
+ * @return false - the token needs the slow path, p is left untouched
+ */
+static bool parse_int(const char *&p, const char *end, int &out) {
+  const char *q = p;
+  const bool neg = q != end && *q == '-';
+  if (q != end && (*q == '-' || *q == '+')) q++;
+
+  int value = 0, digits = 0;
+  for (; q != end && is_digit(*q); q++, digits++) {
+    if (digits == 9) return false; // could overflow
+    value = value * 10 + (*q - '0');
+  }
+  if (digits == 0 || !at_token_end(q, end)) return false;
+
+  out = neg ? -value : value;
+  p = q;
+  return true;
+}
+
+/**
+ * @brief parse a plain decimal number, as %lf would, when the result can be
+ * computed exactly with a single rounding (Clinger's fast path)
+ *
+ * @return true - the token was parsed, p is moved past it
+ * @return false - the token needs the slow path, p is left untouched
+ */
+static bool parse_double(const char *&p, const char *end, double &out) {
+  // every power of ten that is exactly representable as a double
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  static const uint64_t max_mantissa = uint64_t(1) << 53;
+
+  const char *q = p;
+  const bool neg = q != end && *q == '-';
+  if (q != end && (*q == '-' || *q == '+')) q++;
+
+  uint64_t mantissa = 0;
+  int significant = 0; // digits accumulated in the mantissa
+  int digits = 0;      // all the digits of the number
+  int exponent = 0;    // decimal exponent of the mantissa
+
+  for (; q != end && is_digit(*q); q++, digits++) {
+    if (mantissa == 0 && *q == '0') continue; // leading zero
+    if (++significant > 19) return false;
+    mantissa = mantissa * 10 + static_cast<uint64_t>(*q - '0');
+  }
+  if (q != end && *q == '.') {
+    for (q++; q != end && is_digit(*q); q++, digits++) {
+      exponent--;
+      if (mantissa == 0 && *q == '0') continue; // leading zero
+      if (++significant > 19) return false;
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*q - '0');
+    }
+  }
+  if (digits == 0) return false; // inf, nan, a lone sign or dot...
+
+  if (q != end && (*q == 'e' || *q == 'E')) {
+    q++;
+    const bool eneg = q != end && *q == '-';
+    if (q != end && (*q == '-' || *q == '+')) q++;
+    if (q == end || !is_digit(*q)) return false; // scanf and strtod differ
+
+    int e = 0;
+    for (; q != end && is_digit(*q); q++) {
+      if (e < 10000) e = e * 10 + (*q - '0');
+    }
+    exponent += eneg ? -e : e;
+  }
+  if (!at_token_end(q, end)) return false; // hexadecimal, or a bad separator
+
+  double value;
+  if (mantissa == 0) {
+    value = 0.0;
+  } else if (mantissa > max_mantissa || exponent < -22 || exponent > 22) {
+    return false; // would need more than one rounding
+  } else if (exponent < 0) {
+    value = static_cast<double>(mantissa) / pow10[-exponent];
+  } else {
+    value = static_cast<double>(mantissa) * pow10[exponent];
+  }
+
+  out = neg ? -value : value;
+  p = q;
+  return true;
+}
+
+/// @brief sscanf the remaining fields, starting from the given one
+static int scan_fields(const char *s, Box &box, const int field) {
+  switch (field) {
+  case 0:
+    return sscanf(s, "%d %lf %lf %lf %lf %lf", &box.cls, &box.cx, &box.cy,
+                  &box.w, &box.h, &box.score);
+  case 1:
+    return sscanf(s, "%lf %lf %lf %lf %lf", &box.cx, &box.cy, &box.w, &box.h,
+                  &box.score);
+  case 2:
+    return sscanf(s, "%lf %lf %lf %lf", &box.cy, &box.w, &box.h, &box.score);
+  case 3:
+    return sscanf(s, "%lf %lf %lf", &box.w, &box.h, &box.score);
+  case 4:
+    return sscanf(s, "%lf %lf", &box.h, &box.score);
+  default:
+    return sscanf(s, "%lf", &box.score);
+  }
+}
+
+/// @brief hand the rest of the line to sscanf, for the unusual tokens
+static int parse_slow(const char *p, const char *end, Box &box,
+                      const int field) {
+  char buffer[256]; // most lines fit, without allocating
+  const size_t size = static_cast<size_t>(end - p);
+
+  int err;
+  if (size < sizeof(buffer)) {
+    memcpy(buffer, p, size);
+    buffer[size] = '\0';
+    err = scan_fields(buffer, box, field);
+  } else {
+    const std::string line(p, size);
+    err = scan_fields(line.c_str(), box, field);
+  }
+
+  if (err == EOF) return field == 0 ? EOF : field;
+  return field + err;
+}
+
+int parse_box(const char *line, const char *end, Box &box) {
+  double *const fields[] = {&box.cx, &box.cy, &box.w, &box.h, &box.score};
+  const char *p = line;
+
+  while (p != end && is_space(*p)) p++;
+  if (p == end) return EOF; // nothing to convert
+
+  if (!parse_int(p, end, box.cls)) return parse_slow(p, end, box, 0);
+
+  for (int field = 1; field < 6; field++) {
+    while (p != end && is_space(*p)) p++;
+    if (p == end) return field; // the line is too short
+
+    if (!parse_double(p, end, *fields[field - 1])) {
+      return parse_slow(p, end, box, field);
+    }
+  }
+
+  return 6;
+}
+
+LabelStatus read_labels(const std::string &path, std::vector<Box> &boxes) {
+  const MappedFile file(path);
+  if (!file.is_open()) return LabelStatus::unreadable;
+
+  const char *p = file.data();
+  const char *const end = p + file.size();
+
+  Box box = Box(); // reused, like the fields sscanf could not convert
+  while (p != end) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (eol == nullptr) eol = end; // last line, without a newline
+
+    if (parse_box(p, eol, box) == EOF) return LabelStatus::malformed;
+    boxes.push_back(box);
+
+    p = (eol == end) ? end : eol + 1;
+  }
+
+  return LabelStatus::ok;
+}
+
+std::string LabelSource::signature() const { return location(""); }
+
+unsigned long LabelSource::dropped() const { return 0; }
+
+/// @brief corners and area of a box, for the overlap tests
+struct Extent {
+  double x1, y1, x2, y2, area;
+
+  explicit Extent(const Box &b)
+      : x1(b.cx - b.w / 2), y1(b.cy - b.h / 2), x2(b.cx + b.w / 2),
+        y2(b.cy + b.h / 2), area(std::max(0.0, b.w) * std::max(0.0, b.h)) {}
+
+  double iou(const Extent &o) const {
+    const double w = std::min(x2, o.x2) - std::max(x1, o.x1);
+    const double h = std::min(y2, o.y2) - std::max(y1, o.y1);
+    if (w <= 0 || h <= 0) return 0;
+    const double inter = w * h;
+    return inter / (area + o.area - inter);
+  }
+};
+
+size_t suppress_overlaps(std::vector<Box> &boxes, const double iou) {
+  const size_t n = boxes.size();
+  if (n < 2) return 0;
+
+  // by class, then best score first (ties keep the order of the labels)
+  std::vector<size_t> order(n);
+  for (size_t k = 0; k < n; k++)
+    order[k] = k;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (boxes[a].cls != boxes[b].cls) return boxes[a].cls < boxes[b].cls;
+    return boxes[a].score > boxes[b].score;
+  });
+
+  std::vector<bool> keep(n, false);
+  std::vector<Extent> kept; // kept boxes of the current class, sorted by x1
+  double widest = 0;        // width of the widest kept box of the class
+
+  for (size_t k = 0; k < n; k++) {
+    const Box &box = boxes[order[k]];
+    if (k == 0 || box.cls != boxes[order[k - 1]].cls) {
+      kept.clear();
+      widest = 0;
+    }
+
+    // only the kept boxes starting in (x1 - widest, x2) may overlap, with a
+    // little slack for the rounding of the widths
+    const Extent e(box);
+    auto by_x1 = [](const Extent &a, const double x) { return a.x1 < x; };
+    auto it = std::lower_bound(kept.begin(), kept.end(),
+                               e.x1 - widest - 1e-9, by_x1);
+    bool suppressed = false;
+    for (; it != kept.end() && it->x1 < e.x2; ++it) {
+      if (it->iou(e) > iou) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (suppressed) continue;
+
+    keep[order[k]] = true;
+    kept.insert(std::lower_bound(kept.begin(), kept.end(), e.x1, by_x1), e);
+    widest = std::max(widest, e.x2 - e.x1);
+  }
+
+  size_t m = 0;
+  for (size_t k = 0; k < n; k++) {
+    if (keep[k]) boxes[m++] = boxes[k];
+  }
+  boxes.resize(m);
+  return n - m;
+}
+
+LabelFolder::LabelFolder(const std::string &path) : _path(path) {}
+
+LabelStatus LabelFolder::read(const std::string &stem,
+                              std::vector<Box> &boxes) const {
+  return read_labels(location(stem), boxes);
+}
+
+std::string LabelFolder::location(const std::string &stem) const {
+  return _path + stem + ".txt";
+}
+
+std::string image_stem(const char *begin, const char *end) {
+  for (const char *p = begin; p != end; p++) {
+    if (*p == '/') begin = p + 1;
+  }
+  const char *dot = end;
+  for (const char *p = begin; p != end; p++) {
+    if (*p == '.') dot = p;
+  }
+  return std::string(begin, dot);
+}
+
+LabelTable::LabelTable(const std::string &path) : _path(path) {}
+
+void LabelTable::add(const std::string &stem, const Box &box) {
+  _boxes[stem].push_back(box);
+  _rows++;
+}
+
+void LabelTable::add(const std::string &stem, std::vector<Box> &&boxes) {
+  _rows += boxes.size();
+  std::vector<Box> &table = _boxes[stem];
+  if (table.empty()) {
+    table = std::move(boxes);
+  } else {
+    table.insert(table.end(), boxes.begin(), boxes.end());
+  }
+}
+
+LabelStatus LabelTable::read(const std::string &stem,
+                             std::vector<Box> &boxes) const {
+  const auto it = _boxes.find(stem);
+  if (it != _boxes.end()) {
+    boxes.insert(boxes.end(), it->second.begin(), it->second.end());
+  } // an image without any object is not in the table
+  return LabelStatus::ok;
+}
+
+std::string LabelTable::location(const std::string &stem) const {
+  return _path + ':' + stem;
+}
+
+size_t LabelTable::images() const { return _boxes.size(); }
+
+size_t LabelTable::rows() const { return _rows; }
+
+/// @brief number of blank separated fields of a line
+static int count_fields(const char *p, const char *const end) {
+  int n = 0;
+  while (p != end) {
+    while (p != end && is_space(*p)) p++;
+    if (p == end) break;
+    n++;
+    while (p != end && !is_space(*p)) p++;
+  }
+  return n;
+}
+
+LabelIndex::LabelIndex(const std::string &path) : LabelTable(path) {
+  const MappedFile file(path);
+  if (!file.is_open()) {
+    panic("could not open label index '" + path + (char)047);
+  }
+
+  const char *p = file.data();
+  const char *const end = p + file.size();
+  std::string fields; // the fields after the image name, blank separated
+  bool first = true;  // the first row that is neither blank nor a comment
+
+  for (size_t row = 1; p != end; row++) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (eol == nullptr) eol = end; // last row, without a newline
+    const char *const next = (eol == end) ? end : eol + 1;
+
+    while (eol != p && is_space(eol[-1])) eol--;
+    const char *text = p; // first character that is not blank
+    while (text != eol && is_space(*text)) text++;
+    if (text == eol || *text == '#') { // blank row or comment
+      p = next;
+      continue;
+    }
+
+    const char *sep = p; // end of the image name
+    while (sep != eol && *sep != '\t' && *sep != ',') sep++;
+    const char *name = p, *last = sep; // the image name, without the blanks
+    while (name != last && is_space(*name)) name++;
+    while (last != name && is_space(last[-1])) last--;
+
+    fields.assign(sep == eol ? eol : sep + 1, eol);
+    std::replace(fields.begin(), fields.end(), ',', ' ');
+
+    Box box = Box();
+    box.score = 1.0; // ground truth, without a confidence
+    const char *const f = fields.data();
+    const int err = parse_box(f, f + fields.size(), box);
+    const bool header = first;
+    first = false;
+    // a confidence that is there must be a number
+    if (err < 5 || (err == 5 && count_fields(f, f + fields.size()) > 5)) {
+      if (header) {
+        p = next;
+        continue;
+      }
+      panic("malformed row " + std::to_string(row) + " in label index '" +
+            path + (char)047);
+    }
+
+    add(image_stem(name, last), box);
+    p = next;
+  }
+}
+
+/*
+ * layout of a label cache, in the byte order of the machine that wrote it:
+ * CacheHeader, the source signature, CacheEntry[images], the image names, then
+ * cx, cy, w, h and score as double[boxes] and cls as int32_t[boxes] ; every
+ * section starts on 8 bytes
+ */
+
+static const char cache_magic[8] = {'Y', 'O', 'L', 'O', 'L', 'B', 'L', 'C'};
+static const uint32_t cache_version = 3;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t source_length; // length of the source signature
+  uint64_t images;        // number of entries
+  uint64_t boxes;         // number of objects
+  uint64_t names_length;  // length of all the image names
+};
+
+struct CacheEntry {
+  int64_t mtime_sec;  // modification time of the config file
+  int64_t mtime_nsec; // (nanoseconds)
+  int64_t size;       // size of the config file, -1 if it did not exist
+  uint64_t first;     // first object of the image
+  uint32_t count;     // number of objects of the image
+  int32_t status;     // LabelStatus of the config file
+  uint32_t name;      // offset of the image name
+  uint32_t length;    // length of the image name
+  uint32_t dropped;   // number of objects left out by the source
+  uint32_t padding;
+};
+
+static inline uint64_t align8(const uint64_t n) { return (n + 7) & ~7ull; }
+
+/// @brief offsets of the sections of a cache, from its header
+struct CacheLayout {
+  uint64_t source, entries, names, fields, cls, size;
+
+  explicit CacheLayout(const CacheHeader &h) {
+    source = sizeof(CacheHeader);
+    entries = align8(source + h.source_length);
+    names = entries + h.images * sizeof(CacheEntry);
+    fields = align8(names + h.names_length);
+    cls = fields + 5 * h.boxes * sizeof(double);
+    size = cls + h.boxes * sizeof(int32_t);
+  }
+};
+
+/// @brief size and modification time of a config file
+static void stamp(const std::string &path, CacheEntry &entry) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1) {
+    entry.mtime_sec = entry.mtime_nsec = 0;
+    entry.size = -1;
+  } else {
+    entry.mtime_sec = st.st_mtim.tv_sec;
+    entry.mtime_nsec = st.st_mtim.tv_nsec;
+    entry.size = st.st_size;
+  }
+}
+
+LabelCache::LabelCache(const std::string &path, const LabelSource &files,
+                       const std::vector<std::string> &stems)
+    : _files(files), _dropped(0) {
+  const std::string signature = _files.signature();
+  bool fresh = map(path, signature);
+
+  for (size_t k = 0; fresh && k < stems.size(); k++) {
+    const auto it = _index.find(stems[k]);
+    if (it == _index.end()) {
+      fresh = false; // a new image
+      break;
+    }
+    const CacheEntry &cached = _entries[it->second];
+    CacheEntry current;
+    stamp(_files.location(stems[k]), current);
+    fresh = current.size == cached.size &&
+            current.mtime_sec == cached.mtime_sec &&
+            current.mtime_nsec == cached.mtime_nsec;
+  }
+  if (!fresh) {
+    compile(path, signature, stems);
+    _compiled = true;
+    if (!map(path, signature)) {
+      panic("could not map label cache '" + path + (char)047);
+    }
+  }
+  _baseline = _files.dropped(); // counted again as the cache is read
+}
+
+bool LabelCache::map(const std::string &path, const std::string &signature) {
+  _index.clear();
+  _file.reset(new MappedFile(path));
+
+  const char *data = _file->data();
+  const size_t size = _file->size();
+  if (size < sizeof(CacheHeader)) return false;
+
+  const CacheHeader *h = reinterpret_cast<const CacheHeader *>(data);
+  if (memcmp(h->magic, cache_magic, sizeof(cache_magic)) != 0 ||
+      h->version != cache_version || h->source_length != signature.size()) {
+    return false; // another format, or another source
+  }
+  const CacheLayout layout(*h);
+  if (layout.size != size ||
+      memcmp(data + layout.source, signature.data(), signature.size()) != 0) {
+    return false;
+  }
+
+  _entries = reinterpret_cast<const CacheEntry *>(data + layout.entries);
+  _names = data + layout.names;
+  const double *fields = reinterpret_cast<const double *>(data + layout.fields);
+  _cx = fields;
+  _cy = _cx + h->boxes;
+  _w = _cy + h->boxes;
+  _h = _w + h->boxes;
+  _score = _h + h->boxes;
+  _cls = reinterpret_cast<const int32_t *>(data + layout.cls);
+
+  _index.reserve(h->images);
+  for (size_t k = 0; k < h->images; k++) {
+    const CacheEntry &e = _entries[k];
+    // bounds checked so that no sum wraps around
+    if (e.name > h->names_length || e.length > h->names_length - e.name ||
+        e.first > h->boxes || e.count > h->boxes - e.first || e.status < 0 ||
+        e.status > static_cast<int32_t>(LabelStatus::malformed)) {
+      _index.clear();
+      return false; // corrupted
+    }
+    _index[std::string(_names + e.name, e.length)] = k;
+  }
+  return true;
+}
+
+void LabelCache::compile(const std::string &path,
+                         const std::string &signature,
+                         const std::vector<std::string> &stems) const {
+  std::vector<CacheEntry> entries(stems.size());
+  std::string names;
+  std::vector<Box> boxes;
+
+  for (size_t k = 0; k < stems.size(); k++) {
+    CacheEntry &e = entries[k];
+    memset(&e, 0, sizeof(CacheEntry));
+    stamp(_files.location(stems[k]), e); // before reading, to catch changes
+
+    const unsigned long dropped = _files.dropped();
+    e.first = boxes.size();
+    e.status = static_cast<int32_t>(_files.read(stems[k], boxes));
+    e.count = static_cast<uint32_t>(boxes.size() - e.first);
+    e.dropped = static_cast<uint32_t>(_files.dropped() - dropped);
+    e.name = static_cast<uint32_t>(names.size());
+    e.length = static_cast<uint32_t>(stems[k].size());
+    names += stems[k];
+  }
+
+  CacheHeader h;
+  memset(&h, 0, sizeof(CacheHeader));
+  memcpy(h.magic, cache_magic, sizeof(cache_magic));
+  h.version = cache_version;
+  h.source_length = static_cast<uint32_t>(signature.size());
+  h.images = entries.size();
+  h.boxes = boxes.size();
+  h.names_length = names.size();
+  const CacheLayout layout(h);
+
+  // the struct of arrays, then the whole file in one buffer
+  std::vector<char> data(layout.size, 0);
+  char *const base = data.data();
+  memcpy(base, &h, sizeof(CacheHeader));
+  memcpy(base + layout.source, signature.data(), signature.size());
+  memcpy(base + layout.entries, entries.data(),
+         entries.size() * sizeof(CacheEntry));
+  memcpy(base + layout.names, names.data(), names.size());
+
+  double *fields = reinterpret_cast<double *>(base + layout.fields);
+  int32_t *cls = reinterpret_cast<int32_t *>(base + layout.cls);
+  const size_t n = boxes.size();
+  for (size_t k = 0; k < n; k++) {
+    fields[k] = boxes[k].cx;
+    fields[n + k] = boxes[k].cy;
+    fields[2 * n + k] = boxes[k].w;
+    fields[3 * n + k] = boxes[k].h;
+    fields[4 * n + k] = boxes[k].score;
+    cls[k] = boxes[k].cls;
+  }
+
+  // written aside then renamed, so that a cache is never half written
+  const std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == nullptr) {
+    panic("could not write label cache '" + tmp + (char)047);
+  }
+  const bool written = fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (fclose(f) != 0 || !written) {
+    panic("could not write label cache '" + tmp + (char)047);
+  }
+  chk(rename(tmp.c_str(), path.c_str()));
+}
+
+LabelStatus LabelCache::read(const std::string &stem,
+                             std::vector<Box> &boxes) const {
+  const auto it = _index.find(stem);
+  if (it == _index.end()) return _files.read(stem, boxes); // not compiled
+
+  const CacheEntry &e = _entries[it->second];
+  for (uint64_t k = e.first; k < e.first + e.count; k++) {
+    Box box;
+    box.cls = _cls[k];
+    box.cx = _cx[k];
+    box.cy = _cy[k];
+    box.w = _w[k];
+    box.h = _h[k];
+    box.score = _score[k];
+    boxes.push_back(box);
+  }
+  if (e.dropped > 0) _dropped += e.dropped;
+  return static_cast<LabelStatus>(e.status);
+}
+
+std::string LabelCache::location(const std::string &stem) const {
+  return _files.location(stem);
+}
+
+unsigned long LabelCache::dropped() const {
+  // the images missing from the cache are read from the files
+  return _dropped + (_files.dropped() - _baseline);
+}
+
+bool LabelCache::compiled() const { return _compiled; }
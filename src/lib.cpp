@@ -174,3 +174,37 @@ unsigned count_files_in_folder(const std::string &path,
   }
   return count;
 }
+
+bool read_file(const std::string &path, std::vector<unsigned char> &bytes) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+
+  struct stat st;
+  bool success = fstat(fd, &st) == 0;
+  bytes.resize(success ? static_cast<size_t>(st.st_size) : 0);
+  size_t done = 0;
+  while (success && done < bytes.size()) {
+    const ssize_t n = read(fd, bytes.data() + done, bytes.size() - done);
+    if (n == -1 && errno == EINTR) continue;
+    success = n > 0;
+    done += success ? static_cast<size_t>(n) : 0;
+  }
+  chk(close(fd));
+  return success;
+}
+
+bool write_file(const std::string &path,
+                const std::vector<unsigned char> &bytes) {
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1) return false;
+
+  bool success = true;
+  size_t done = 0;
+  while (success && done < bytes.size()) {
+    const ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+    if (n == -1 && errno == EINTR) continue;
+    success = n > 0;
+    done += success ? static_cast<size_t>(n) : 0;
+  }
+  return close(fd) == 0 && success;
+}
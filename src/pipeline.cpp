@@ -0,0 +1,114 @@
+#include "pipeline.h"
+
+MemoryBudget::MemoryBudget(const size_t budget, const unsigned overtakes)
+    : _budget(budget), _overtakes(overtakes) {}
+
+bool MemoryBudget::acquire(const size_t bytes, unsigned long long &waited) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  const unsigned long ticket = _next++;
+  _queue.push_back(ticket);
+  auto fits = [this, bytes, ticket]() {
+    if (_budget != 0 && _used != 0 && _used + bytes > _budget) return false;
+    return ticket == _queue.front() || _overtaken < _overtakes;
+  };
+  if (!fits()) {
+    const auto t0 = std::chrono::steady_clock::now();
+    _released.wait(lock, fits);
+    waited += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - t0)
+                  .count();
+  }
+  _used += bytes;
+  _peak = std::max(_peak, _used);
+  if (ticket == _queue.front()) {
+    _queue.pop_front();
+    _overtaken = 0; // the next one is the oldest now
+  } else {
+    _queue.erase(std::find(_queue.begin(), _queue.end(), ticket));
+    _overtaken++;
+  }
+  lock.unlock();
+  _released.notify_all(); // the next request may fit as well
+  return _budget != 0 && bytes > _budget;
+}
+
+void MemoryBudget::release(const size_t bytes) {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _used -= bytes;
+  }
+  _released.notify_all();
+}
+
+size_t MemoryBudget::peak() {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _peak;
+}
+
+std::vector<size_t> split_ranges(const std::vector<double> &weights,
+                                 size_t parts) {
+  const size_t n = weights.size();
+  parts = std::max<size_t>(std::min(parts, n), 1);
+
+  double total = 0;
+  for (const double w : weights)
+    total += w;
+
+  // a range ends once the running weight passes its share of the total
+  std::vector<size_t> bounds(1, 0);
+  double sum = 0;
+  for (size_t k = 0; k < n; k++) {
+    sum += weights[k];
+    const size_t done = bounds.size(); // ranges closed so far, plus one
+    if (done < parts && k + 1 < n && sum >= total * done / parts) {
+      bounds.push_back(k + 1);
+    }
+  }
+  if (n > 0) bounds.push_back(n);
+  return bounds;
+}
+
+std::vector<size_t> split_batches(const std::vector<double> &pixels,
+                                  const int workers) {
+  double total = 0;
+  for (const double p : pixels)
+    total += p;
+  const size_t parts = std::min(static_cast<size_t>(std::max(workers, 1)),
+                                static_cast<size_t>(total / batch_pixels));
+  return split_ranges(pixels, parts);
+}
+
+Stage::Stage(const std::string &name, const int workers)
+    : _name(name), _workers(std::max(workers, 1)), _items(0), _active(0),
+      _starved(0), _blocked(0) {}
+
+Stage::~Stage() { join(); }
+
+int Stage::workers() const { return _workers; }
+
+void Stage::blocked_for(const unsigned long long ns) { _blocked += ns; }
+
+void Stage::join() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _left.wait(lock, [this] { return _running == 0; });
+}
+
+std::string Stage::report(const double seconds) const {
+  // share of the time of all the workers
+  const double total = seconds * _workers * 1e9;
+  auto percent = [total](const double ns) {
+    return total > 0 ? static_cast<int>(100 * ns / total + 0.5) : 0;
+  };
+  const double blocked = static_cast<double>(_blocked);
+  const double busy = std::max(static_cast<double>(_active) - blocked, 0.0);
+
+  std::stringstream ss;
+  ss << "stage " << std::left << std::setw(7) << _name << std::right
+     << std::setw(3) << _workers << " worker(s) " << std::setw(7) << _items
+     << " item(s) " << std::setw(3) << percent(busy) << "% busy "
+     << std::setw(3) << percent(_starved) << "% starved " << std::setw(3)
+     << percent(blocked) << "% blocked, queue " << std::fixed
+     << std::setprecision(1) << (_depth ? _depth() : 0.0) << '/'
+     << _capacity;
+  return ss.str();
+}
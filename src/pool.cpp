@@ -0,0 +1,138 @@
+#include "pool.h"
+
+const int ThreadPool::spin;
+
+// the pool and the id of the worker running on this thread, if any
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local int current_id = EOF;
+
+// initial capacity of the deques
+static const size_t initial_capacity = 1 << 6;
+
+void ThreadPool::Worker::grow(const size_t capacity) {
+  std::vector<Task> larger(capacity);
+  for (size_t k = 0; k < count; k++)
+    larger[k] = std::move(ring[(head + k) & (ring.size() - 1)]);
+  ring.swap(larger);
+  head = 0;
+}
+
+ThreadPool::ThreadPool(int n)
+    : _pending(0), _sleeping(0), _next(0), _stop(false) {
+  n = std::max(n, 1);
+  for (int id = 0; id < n; id++) {
+    _workers.emplace_back(new Worker());
+    _workers.back()->grow(initial_capacity);
+  }
+  for (int id = 0; id < n; id++)
+    _threads.emplace_back(&ThreadPool::run, this, id);
+}
+
+ThreadPool::~ThreadPool() { stop(true); }
+
+int ThreadPool::size() const { return static_cast<int>(_workers.size()); }
+
+void ThreadPool::reserve(const size_t tasks) {
+  const size_t share = tasks / _workers.size() + 1;
+  for (auto &w : _workers) {
+    std::lock_guard<std::mutex> guard(w->mutex);
+    size_t capacity = std::max(w->ring.size(), initial_capacity);
+    while (capacity < w->count + share)
+      capacity *= 2;
+    if (capacity != w->ring.size()) w->grow(capacity);
+  }
+}
+
+bool ThreadPool::pop(const int id, Task &task) {
+  const int n = size();
+  for (int k = 0; k < n; k++) {
+    Worker &w = *_workers[(id + k) % n];
+    std::lock_guard<std::mutex> guard(w.mutex);
+    if (w.count == 0) continue;
+
+    const size_t mask = w.ring.size() - 1;
+    if (k == 0) { // our own tasks, oldest first
+      task = std::move(w.ring[w.head]);
+      w.head = (w.head + 1) & mask;
+    } else { // stolen, newest first so that the owner is not disturbed
+      task = std::move(w.ring[(w.head + w.count - 1) & mask]);
+    }
+    w.count--;
+    _pending--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run(const int id) {
+  current_pool = this;
+  current_id = id;
+
+  Task task;
+  for (;;) {
+    bool found = false;
+    for (int k = 0; k < spin && !found; k++) {
+      found = _pending > 0 && pop(id, task);
+      if (!found) std::this_thread::yield();
+    }
+
+    if (found) {
+      task(id);
+      task.reset(); // release the captures now
+      continue;
+    }
+
+    // park until a task is queued, a submitter that saw _sleeping == 0 has
+    // incremented _pending before, so it cannot be missed
+    std::unique_lock<std::mutex> lock(_park_mutex);
+    _sleeping++;
+    _park.wait(lock, [this] { return _pending > 0 || _stop; });
+    _sleeping--;
+    if (_stop && _pending == 0) return;
+  }
+}
+
+void ThreadPool::submit(Task &&task) {
+  const int id = current_pool == this ? current_id : _next++ % size();
+  {
+    Worker &w = *_workers[id];
+    std::lock_guard<std::mutex> guard(w.mutex);
+    if (w.count == w.ring.size())
+      w.grow(std::max(2 * w.count, initial_capacity));
+    w.ring[(w.head + w.count) & (w.ring.size() - 1)] = std::move(task);
+    w.count++;
+  }
+  _pending++;
+
+  if (_sleeping > 0) {
+    std::lock_guard<std::mutex> guard(_park_mutex);
+    _park.notify_one();
+  }
+}
+
+void ThreadPool::stop(const bool wait) {
+  if (_threads.empty()) return; // already stopped
+
+  if (!wait) {
+    for (auto &w : _workers) {
+      std::vector<Task> dropped; // destroyed outside of the lock
+      size_t count;
+      {
+        std::lock_guard<std::mutex> guard(w->mutex);
+        dropped.swap(w->ring);
+        count = w->count;
+        w->head = w->count = 0;
+      }
+      _pending -= count;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(_park_mutex);
+    _stop = true;
+    _park.notify_all();
+  }
+  for (auto &t : _threads)
+    t.join();
+  _threads.clear();
+}
@@ -0,0 +1,251 @@
+#include "voc.h"
+
+/// @brief a piece of the mapped file, compared without copying it
+struct Slice {
+  const char *p;
+  size_t n;
+
+  bool operator==(const char *s) const {
+    return strlen(s) == n && memcmp(p, s, n) == 0;
+  }
+};
+
+/// @brief the fields of an <object>, before normalization
+struct VocObject {
+  Slice name;
+  double difficult;
+  double xmin, ymin, xmax, ymax;
+  unsigned found; // bit mask of the fields read
+};
+
+// bits of VocObject::found
+enum { found_name = 1, found_box = 2 + 4 + 8 + 16 };
+
+static inline bool is_blank(const char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static Slice trim(const char *p, const char *end) {
+  while (p != end && is_blank(*p)) p++;
+  while (end != p && is_blank(end[-1])) end--;
+  return Slice{p, static_cast<size_t>(end - p)};
+}
+
+static bool to_number(const Slice &s, double &out) {
+  char buffer[64];
+  if (s.n == 0 || s.n >= sizeof(buffer)) return false;
+  memcpy(buffer, s.p, s.n);
+  buffer[s.n] = '\0';
+
+  char *last;
+  out = strtod(buffer, &last);
+  return last == buffer + s.n;
+}
+
+/// @brief the text of a leaf element, with the predefined entities decoded
+static std::string decode(const Slice &s) {
+  static const char *const entities[] = {"&amp;", "&lt;", "&gt;", "&quot;",
+                                         "&apos;"};
+  static const char chars[] = {'&', '<', '>', '"', '\''};
+
+  std::string text;
+  text.reserve(s.n);
+  for (size_t k = 0; k < s.n;) {
+    size_t e = s.p[k] == '&' ? 0 : 5; // the entity found, 5 for none
+    for (; e < 5; e++) {
+      const size_t n = strlen(entities[e]);
+      if (n <= s.n - k && memcmp(s.p + k, entities[e], n) == 0) break;
+    }
+    if (e < 5) {
+      text += chars[e];
+      k += strlen(entities[e]);
+    } else {
+      text += s.p[k++]; // plain text, or an entity left as is
+    }
+  }
+  return text;
+}
+
+/// @brief the end of a markup, or nullptr
+static const char *find(const char *p, const char *end, const char *what) {
+  const size_t n = strlen(what);
+  for (; static_cast<size_t>(end - p) >= n; p++) {
+    if (memcmp(p, what, n) == 0) return p + n;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief walk the elements of a VOC annotation, keeping only the image size
+ * and the objects
+ *
+ * @return true - the document is well formed, with every field we need
+ * @return false - the document is malformed
+ */
+static bool parse_voc(const char *p, const char *const end, double &width,
+                      double &height, std::vector<VocObject> &objects) {
+  static const size_t max_depth = 8; // deeper elements are not named
+  Slice stack[max_depth];            // the open elements
+  size_t depth = 0;
+  VocObject object = VocObject();
+
+  while (p != end) {
+    const char *lt = static_cast<const char *>(memchr(p, '<', end - p));
+    if (lt == nullptr) break; // trailing blanks
+    const Slice text = trim(p, lt); // the content of a leaf element
+
+    p = lt + 1;
+    if (p == end) return false;
+
+    if (*p == '?') { // declaration
+      p = find(p, end, "?>");
+    } else if (*p == '!') { // comment, CDATA or DOCTYPE
+      if (end - p >= 3 && memcmp(p, "!--", 3) == 0) {
+        p = find(p, end, "-->");
+      } else if (end - p >= 8 && memcmp(p, "![CDATA[", 8) == 0) {
+        p = find(p, end, "]]>");
+      } else {
+        p = find(p, end, ">");
+      }
+    } else {
+      const bool closing = *p == '/';
+      if (closing) p++;
+
+      const char *q = p;
+      while (q != end && !is_blank(*q) && *q != '/' && *q != '>') q++;
+      const Slice name = Slice{p, static_cast<size_t>(q - p)};
+
+      char quote = 0; // attribute values may hold a '>'
+      for (; q != end && (quote != 0 || *q != '>'); q++) {
+        if (quote != 0 && *q == quote) {
+          quote = 0;
+        } else if (quote == 0 && (*q == '"' || *q == '\'')) {
+          quote = *q;
+        }
+      }
+      if (q == end || name.n == 0) return false;
+      const bool empty = q[-1] == '/'; // <tag/>
+      p = q + 1;
+
+      if (closing) {
+        if (depth == 0) return false;
+        if (depth <= max_depth) {
+          const Slice &open = stack[depth - 1];
+          if (open.n != name.n || memcmp(open.p, name.p, name.n) != 0) {
+            return false; // mismatched tags
+          }
+        }
+
+        if (depth == 3 && stack[1] == "size") {
+          if (name == "width" && !to_number(text, width)) return false;
+          if (name == "height" && !to_number(text, height)) return false;
+        } else if (depth == 3 && stack[1] == "object") {
+          if (name == "name") {
+            object.name = text;
+            object.found |= found_name;
+          } else if (name == "difficult" &&
+                     !to_number(text, object.difficult)) {
+            return false;
+          }
+        } else if (depth == 4 && stack[1] == "object" &&
+                   stack[2] == "bndbox") {
+          double *const coordinates[] = {&object.xmin, &object.ymin,
+                                         &object.xmax, &object.ymax};
+          static const char *const tags[] = {"xmin", "ymin", "xmax", "ymax"};
+          for (int k = 0; k < 4; k++) {
+            if (!(name == tags[k])) continue;
+            if (!to_number(text, *coordinates[k])) return false;
+            object.found |= 2u << k;
+          }
+        } else if (depth == 2 && name == "object") {
+          objects.push_back(object);
+        }
+        depth--;
+      } else if (!empty) {
+        if (depth < max_depth) stack[depth] = name;
+        depth++;
+        if (depth == 2 && name == "object") object = VocObject();
+      }
+    }
+
+    if (p == nullptr) return false; // unterminated markup
+  }
+
+  return depth == 0;
+}
+
+VocFolder::VocFolder(const std::string &path, const std::string &names)
+    : _path(path), _unknown(0) {
+  const MappedFile file(names);
+  if (!file.is_open()) {
+    panic("could not open names file '" + names + (char)047);
+  }
+
+  const char *p = file.data();
+  const char *const end = p + file.size();
+  for (int cls = 0; p != end; cls++) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (eol == nullptr) eol = end; // last line, without a newline
+
+    const Slice name = trim(p, eol);
+    if (name.n > 0) {
+      _classes.insert(std::make_pair(std::string(name.p, name.n), cls));
+    }
+    _names.append(name.p, name.n).append(1, '\n');
+
+    p = (eol == end) ? end : eol + 1;
+  }
+}
+
+LabelStatus VocFolder::read(const std::string &stem,
+                            std::vector<Box> &boxes) const {
+  const MappedFile file(location(stem));
+  if (!file.is_open()) return LabelStatus::unreadable;
+
+  thread_local std::vector<VocObject> objects; // reused across images
+  objects.clear();
+
+  double width = 0, height = 0;
+  if (!parse_voc(file.data(), file.data() + file.size(), width, height,
+                 objects) ||
+      width <= 0 || height <= 0) {
+    return LabelStatus::malformed;
+  }
+
+  for (const VocObject &o : objects) {
+    if ((o.found & (found_name | found_box)) != (found_name | found_box)) {
+      return LabelStatus::malformed;
+    }
+  }
+
+  for (const VocObject &o : objects) {
+    if (o.difficult != 0) continue;
+
+    const auto it = _classes.find(decode(o.name));
+    if (it == _classes.end()) {
+      _unknown++;
+      continue;
+    }
+
+    // same conversion as voc_label.py
+    Box box;
+    box.cls = it->second;
+    box.cx = ((o.xmin + o.xmax) / 2.0 - 1) / width;
+    box.cy = ((o.ymin + o.ymax) / 2.0 - 1) / height;
+    box.w = (o.xmax - o.xmin) / width;
+    box.h = (o.ymax - o.ymin) / height;
+    box.score = 1.0;
+    boxes.push_back(box);
+  }
+  return LabelStatus::ok;
+}
+
+std::string VocFolder::location(const std::string &stem) const {
+  return _path + stem + ".xml";
+}
+
+std::string VocFolder::signature() const {
+  return "voc:" + location("") + '\n' + _names;
+}
+
+unsigned long VocFolder::dropped() const { return _unknown; }
@@ -0,0 +1,278 @@
+#include "lib.h"
+
+#include "ctpl.hpp"
+
+#include "image.h"
+#include "kernels.h"
+#include "label.h"
+#include "pool.h"
+
+#include "ref.h"
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+/// @brief time `n` calls of `f` and return the mean duration in microseconds
+template <typename F> static double bench(const unsigned n, F f) {
+  const auto start = bench_clock::now();
+  for (unsigned k = 0; k < n; k++)
+    f(k);
+  const auto stop = bench_clock::now();
+  return std::chrono::duration<double, std::micro>(stop - start).count() / n;
+}
+
+static void report(const std::string &name, const double ref, const double cur) {
+  fprintf(stdout, "%-28s %10.2f us %10.2f us %8.2fx\n", name.c_str(), ref, cur,
+          ref / cur);
+}
+
+static void fill(Image &image) {
+  for (size_t k = 0; k < image.size(); k++)
+    image.data()[k] = static_cast<unsigned char>(k * 31 + (k >> 7));
+}
+
+/// @brief 512x512 crops around the source, some of them partially outside
+static void bench_crop_rect(const unsigned n) {
+  static const int channels[] = {1, 3, 4};
+  for (const int c : channels) {
+    Image source = Image(2048, 2048, c);
+    fill(source);
+
+    auto at = [](unsigned k) { return static_cast<int>(k * 97 % 1800) - 128; };
+
+    const double ref = bench(n, [&](unsigned k) {
+      delete crop_rect_ref(source, at(k), at(k + 1), 512, 512);
+    });
+    const double cur = bench(n, [&](unsigned k) {
+      Image c = source.crop_rect(at(k), at(k + 1), 512, 512);
+    });
+    report("crop_rect 512x512 c=" + std::to_string(c), ref, cur);
+  }
+}
+
+/// @brief 512x384 ellipses around the source, some of them partially outside
+static void bench_crop_ellipse(const unsigned n) {
+  static const int channels[] = {1, 3, 4};
+  for (const int c : channels) {
+    Image source = Image(2048, 2048, c);
+    fill(source);
+
+    auto at = [](unsigned k) { return static_cast<int>(k * 97 % 1800) - 128; };
+
+    const double ref = bench(n, [&](unsigned k) {
+      delete crop_ellipse_ref(source, at(k), at(k + 1), 512, 384);
+    });
+    const double cur = bench(n, [&](unsigned k) {
+      Image c = source.crop_ellipse(at(k), at(k + 1), 512, 384);
+    });
+    report("crop_ellipse 512x384 c=" + std::to_string(c), ref, cur);
+  }
+}
+
+/// @brief 64x64 circles composed over a background, in 96x96 images
+static void bench_crop_background(const unsigned n) {
+  static const int channels[] = {1, 3, 4};
+  for (const int c : channels) {
+    Image source = Image(2048, 2048, c);
+    Image bg = Image(512, 512, c);
+    fill(source);
+    fill(bg);
+
+    auto at = [](unsigned k) { return static_cast<int>(k * 97 % 2000); };
+
+    const double ref = bench(n, [&](unsigned k) {
+      Image *dest = crop_rect_ref(bg, 256 - 48, 256 - 48, 96, 96);
+      delete crop_ellipse_ref(source, at(k), at(k + 1), 64, 64, dest, 96, 96);
+    });
+    const double cur = bench(n, [&](unsigned k) {
+      Image c = source.crop_ellipse(at(k), at(k + 1), 64, 64, &bg, 96, 96);
+    });
+    report("crop_ellipse bg 64/96 c=" + std::to_string(c), ref, cur);
+  }
+}
+
+/// @brief png encode and decode of a 1024x1024 image, for each ISA level
+static void bench_codecs(const unsigned n) {
+  static const char path[] = "bench_codecs.png";
+  Image source = Image(1024, 1024, 3);
+  for (size_t k = 0; k < source.size(); k++)
+    source.data()[k] = static_cast<unsigned char>((k / 3 % 1024) ^ (k >> 12));
+
+  const Kernels *base = kernels_built().front();
+  auto codec = [&](const Kernels *k) {
+    return bench(n, [&](unsigned) {
+      int w, h, c;
+      k->write_png(path, source.width(), source.height(), source.channels(),
+                   source.data(), source.width() * source.channels());
+      k->free(k->load(path, &w, &h, &c, 0));
+    });
+  };
+
+  const double ref = codec(base);
+  for (const Kernels *k : kernels_built()) {
+    report(std::string("png codec 1024x1024 ") + k->isa, ref, codec(k));
+  }
+  remove(path);
+}
+
+/// @brief small 32x32 crops, where the per-crop overhead dominates
+static void bench_crop_small(const unsigned n) {
+  static const int channels[] = {1, 3, 4};
+  for (const int c : channels) {
+    Image source = Image(1024, 1024, c);
+    fill(source);
+
+    auto at = [](unsigned k) { return static_cast<int>(k * 97 % 1000); };
+
+    const double ref = bench(n, [&](unsigned k) {
+      delete crop_rect_ref(source, at(k), at(k + 1), 32, 32);
+    });
+    const double cur = bench(n, [&](unsigned k) {
+      Image c = source.crop_rect(at(k), at(k + 1), 32, 32);
+    });
+    report("crop_rect 32x32 c=" + std::to_string(c), ref, cur);
+  }
+}
+
+/// @brief parse a config file of 100000 objects, getline and sscanf against
+/// the memory-mapped parser
+static void bench_labels(const unsigned n) {
+  static const char path[] = "bench_labels.txt";
+  static const unsigned lines = 100000;
+
+  FILE *f = fopen(path, "w");
+  for (unsigned k = 0; k < lines; k++) {
+    fprintf(f, "%u %.6f %.6f %.6f %.6f %.7f\n", k % 80, (k % 997) / 997.0,
+            (k % 991) / 991.0, (k % 89) / 97.0, (k % 83) / 97.0,
+            (k % 9973) / 9973.0);
+  }
+  fclose(f);
+
+  std::vector<Box> boxes;
+  const double ref = bench(n, [&](unsigned) {
+    boxes.clear();
+    std::ifstream file(path);
+    std::string line;
+    Box box;
+    while (std::getline(file, line)) {
+      if (sscanf(line.c_str(), "%d %lf %lf %lf %lf %lf", &box.cls, &box.cx,
+                 &box.cy, &box.w, &box.h, &box.score) == EOF)
+        break;
+      boxes.push_back(box);
+    }
+  });
+  const double cur = bench(n, [&](unsigned) {
+    boxes.clear();
+    read_labels(path, boxes);
+  });
+  report("labels 100000 lines", ref, cur);
+  fprintf(stdout, "%-28s %10.2f M/s %9.2f M/s\n", "labels lines/second",
+          lines / ref, lines / cur);
+  remove(path);
+}
+
+/// @brief non maximum suppression of a frame of 4000 overlapping objects
+static void bench_nms(const unsigned n) {
+  std::vector<Box> boxes;
+  for (unsigned k = 0; k < 4000; k++) {
+    Box b;
+    b.cls = k % 4;
+    b.cx = (k * 37 % 1000) / 1000.0;
+    b.cy = (k * 91 % 1000) / 1000.0;
+    b.w = 0.02 + (k % 13) / 200.0;
+    b.h = 0.02 + (k % 7) / 100.0;
+    b.score = (k * 7919 % 1000) / 1000.0;
+    boxes.push_back(b);
+  }
+
+  std::vector<Box> work;
+  const double ref = bench(n, [&](unsigned) {
+    work = boxes;
+    suppress_overlaps_ref(work, 0.5);
+  });
+  const double cur = bench(n, [&](unsigned) {
+    work = boxes;
+    suppress_overlaps(work, 0.5);
+  });
+  report("nms 4000 objects", ref, cur);
+}
+
+/// @brief throughput of many small tasks, ctpl's single queue against the
+/// work-stealing pool, from 1 to 128 threads
+static void bench_pool(const unsigned n) {
+  static const int threads[] = {1, 2, 4, 8, 16, 32, 64, 128};
+  const unsigned tasks = 20000;
+
+  auto work = [](int id) {
+    unsigned x = static_cast<unsigned>(id);
+    for (int k = 0; k < 256; k++)
+      x = x * 1664525u + 1013904223u;
+    return x;
+  };
+
+  for (const int t : threads) {
+    const double ref = bench(n, [&](unsigned) {
+      ctpl::thread_pool pool(t);
+      std::vector<std::future<unsigned>> futures(tasks);
+      for (unsigned k = 0; k < tasks; k++)
+        futures[k] = pool.push(work);
+      for (auto &f : futures)
+        f.get();
+    });
+    const double cur = bench(n, [&](unsigned) {
+      ThreadPool pool(t);
+      std::vector<std::future<unsigned>> futures(tasks);
+      for (unsigned k = 0; k < tasks; k++)
+        futures[k] = pool.push(work);
+      for (auto &f : futures)
+        f.get();
+    });
+    report("pool " + std::to_string(tasks) + " tasks t=" + std::to_string(t),
+           ref, cur);
+    fprintf(stdout, "%-28s %10.2f M/s %9.2f M/s\n", "pool tasks/second",
+            tasks / ref, tasks / cur);
+  }
+}
+
+static void bench_post(const unsigned n) {
+  static const int threads[] = {1, 4, 16};
+  const unsigned tasks = 20000;
+
+  for (const int t : threads) {
+    const double ref = bench(n, [&](unsigned) {
+      ThreadPool pool(t);
+      std::vector<std::future<unsigned>> futures(tasks);
+      for (unsigned k = 0; k < tasks; k++)
+        futures[k] = pool.push([k](int) { return k; });
+      for (auto &f : futures)
+        f.get();
+    });
+    const double cur = bench(n, [&](unsigned) {
+      std::vector<unsigned> results(tasks);
+      ThreadPool pool(t);
+      pool.reserve(tasks);
+      for (unsigned k = 0; k < tasks; k++)
+        pool.post([&results, k](int) { results[k] = k; });
+      pool.stop(true);
+    });
+    report("post " + std::to_string(tasks) + " tasks t=" + std::to_string(t),
+           ref, cur);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const unsigned n = argc > 1 ? std::stoul(argv[1]) : 200;
+
+  fprintf(stdout, "%-28s %13s %13s %9s\n", "kernel", "reference", "current",
+          "speedup");
+  bench_crop_rect(n);
+  bench_crop_ellipse(n);
+  bench_crop_small(500 * n);
+  bench_crop_background(50 * n);
+  bench_codecs(n / 20 + 1);
+  bench_labels(n / 20 + 1);
+  bench_nms(n / 10 + 1);
+  bench_pool(n / 40 + 1);
+  bench_post(n / 40 + 1);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/* ref.h
+Reference (per-pixel) crop kernels, as they were before the span-based
+rewrite, and a naive quadratic non maximum suppression. They are used by the
+tests to check that the current code gives the same results, and by the
+benchmarks as a baseline.
+
+*   the destination image is expected to be large enough to hold the crop,
+no destination clipping is performed (just like the original kernels).
+
+*/
+
+#pragma once
+
+#include "image.h"
+#include "label.h"
+
+static inline Image *crop_rect_ref(const Image &src, int x, int y, int width,
+                                   int height, Image *bg = nullptr,
+                                   int bw = EOF, int bh = EOF) {
+  const int cw = bw == EOF ? width : bw;
+  const int ch = bh == EOF ? height : bh;
+  Image *cropped = bg == nullptr ? new Image(cw, ch, src.channels()) : bg;
+
+  const int c = src.channels();
+  const int w = cropped->width();
+  const int h = cropped->height();
+  const int x0 = w / 2 - width / 2;
+  const int y0 = h / 2 - height / 2;
+
+  for (int i = 0; i < height; i++) {
+    if (i + y >= src.height() || i + y < 0) continue;
+    for (int j = 0; j < width; j++) {
+      if (j + x >= src.width() || j + x < 0) continue;
+      memcpy(cropped->data() + ((y0 + i) * w + x0 + j) * c,
+             src.data() + ((y + i) * src.width() + x + j) * c, c);
+    }
+  }
+
+  return cropped;
+}
+
+static inline Image *crop_ellipse_ref(const Image &src, int x, int y,
+                                      int width, int height,
+                                      Image *bg = nullptr, int bw = EOF,
+                                      int bh = EOF) {
+  const int cw = bw == EOF ? width : bw;
+  const int ch = bh == EOF ? height : bh;
+  Image *cropped = bg == nullptr ? new Image(cw, ch, src.channels()) : bg;
+
+  const float cx = static_cast<float>(x) + width / 2.0f;
+  const float cy = static_cast<float>(y) + height / 2.0f;
+  const float rx = static_cast<float>(width) / 2.0f;
+  const float ry = static_cast<float>(height) / 2.0f;
+
+  const int c = src.channels();
+  const int w = cropped->width();
+  const int h = cropped->height();
+  const int x0 = w / 2 - width / 2;
+  const int y0 = h / 2 - height / 2;
+
+  for (int i = 0; i < height; i++) {
+    if (i + y >= src.height() || i + y < 0) continue;
+    for (int j = 0; j < width; j++) {
+      if (j + x >= src.width() || j + x < 0) continue;
+      const float dx = static_cast<float>(j) + x - cx;
+      const float dy = static_cast<float>(i) + y - cy;
+      if (dx * dx / (rx * rx) + dy * dy / (ry * ry) <= 1) {
+        memcpy(cropped->data() + ((y0 + i) * w + x0 + j) * c,
+               src.data() + ((y + i) * src.width() + x + j) * c, c);
+      }
+    }
+  }
+
+  return cropped;
+}
+
+static inline size_t suppress_overlaps_ref(std::vector<Box> &boxes,
+                                           const double iou) {
+  const size_t n = boxes.size();
+  std::vector<size_t> order(n);
+  for (size_t k = 0; k < n; k++)
+    order[k] = k;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return boxes[a].score > boxes[b].score;
+  });
+
+  std::vector<bool> keep(n, false);
+  std::vector<size_t> kept;
+  for (const size_t i : order) {
+    const Box &a = boxes[i];
+    bool suppressed = false;
+    for (const size_t j : kept) {
+      const Box &b = boxes[j];
+      if (a.cls != b.cls) continue;
+      const double w = std::min(a.cx + a.w / 2, b.cx + b.w / 2) -
+                       std::max(a.cx - a.w / 2, b.cx - b.w / 2);
+      const double h = std::min(a.cy + a.h / 2, b.cy + b.h / 2) -
+                       std::max(a.cy - a.h / 2, b.cy - b.h / 2);
+      if (w <= 0 || h <= 0) continue;
+      const double inter = w * h;
+      if (inter / (a.w * a.h + b.w * b.h - inter) > iou) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (suppressed) continue;
+    keep[i] = true;
+    kept.push_back(i);
+  }
+
+  size_t m = 0;
+  for (size_t k = 0; k < n; k++) {
+    if (keep[k]) boxes[m++] = boxes[k];
+  }
+  boxes.resize(m);
+  return n - m;
+}
@@ -1,10 +1,16 @@
 #include "lib.h"
 
 #include "app.h"
+#include "coco.h"
 #include "ctpl.hpp"
 #include "image.h"
+#include "label.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "voc.h"
 
 #include "m.h"
+#include "ref.h"
 
 #define N 1 << 5
 unsigned long _no_asserts = 0;
@@ -35,34 +41,55 @@ void memory_test_1(void) {
 void memory_test_2(void) {
   const Image image = Image(1920, 1080);
   for (int i = 0; i < N; i++) {
-    const Image *c = image.crop_rect(0, 0, 64, 64);
-    assert_neq(c, nullptr);
-    assert_eq(c->width(), 64);
-    assert_eq(c->height(), 64);
-    assert_eq(c->channels(), 3);
-    assert_eq(c->size(), 64 * 64 * 3);
-    delete c;
+    const Image c = image.crop_rect(0, 0, 64, 64);
+    assert_neq(c.data(), nullptr);
+    assert_eq(c.width(), 64);
+    assert_eq(c.height(), 64);
+    assert_eq(c.channels(), 3);
+    assert_eq(c.size(), 64 * 64 * 3);
   }
 }
 
 void memory_test_3(void) {
   const Image image = Image(1920, 1080);
-  std::vector<Image *> v;
+  std::vector<Image> v;
   for (int i = 0; i < N; i++) {
     v.push_back(image.crop_rect(0, 0, 64, 64));
   }
   for (int i = 0; i < N; i++) {
-    assert_neq(v[i], nullptr);
-    assert_neq(v[i]->data(), nullptr);
+    assert_neq(v[i].data(), nullptr);
     for (int j = 0; j < N; j++) {
       if (i != j) {
-        assert_neq(v[i]->data(), v[j]->data());
+        assert_neq(v[i].data(), v[j].data());
       }
     }
   }
-  for (int i = 0; i < N; i++) {
-    delete v[i];
-  }
+}
+
+void memory_test_4(void) {
+  Image a = Image(64, 64);
+  const unsigned char *data = a.data();
+
+  // moving steals the buffer
+  Image b = std::move(a);
+  assert_eq(data, b.data());
+  assert_eq(a.data(), nullptr);
+  assert_eq(a.size(), 0);
+
+  // cropping into an image reuses its buffer when it is large enough
+  Image c = b.crop_rect(0, 0, 32, 32);
+  const unsigned char *buffer = c.data();
+  b.crop_rect(c, 0, 0, 16, 16);
+  assert_eq(buffer, c.data());
+  assert_eq(c.size(), 16 * 16 * 3);
+  b.crop_ellipse(c, 0, 0, 32, 8);
+  assert_eq(buffer, c.data());
+
+  // copies are deep
+  Image d;
+  d = c;
+  assert_neq(d.data(), c.data());
+  assert_eq(memcmp(d.data(), c.data(), c.size()), 0);
 }
 
 void crop_test_0(void) {
@@ -75,16 +102,15 @@ void crop_test_0(void) {
     }
   }
   for (int i = 0; i < w; i++) {
-    const Image *c = image.crop_rect(0, i, w, 1);
-    assert_neq(c, nullptr);
-    assert_eq(c->width(), w);
-    assert_eq(c->height(), 1);
-    assert_eq(c->channels(), 1);
-    assert_eq(c->size(), w);
+    const Image c = image.crop_rect(0, i, w, 1);
+    assert_neq(c.data(), nullptr);
+    assert_eq(c.width(), w);
+    assert_eq(c.height(), 1);
+    assert_eq(c.channels(), 1);
+    assert_eq(c.size(), w);
     for (int j = 0; j < w; j++) {
-      assert_eq(c->data()[j], i);
+      assert_eq(c.data()[j], i);
     }
-    delete c;
   }
 }
 
@@ -94,13 +120,12 @@ void crop_test_1(void) {
   const int w = image.width();
   const int h = image.height();
 
-  const Image *c = image.crop_rect(0, 0, 2 * w, 2 * h);
-  assert_neq(c, nullptr);
-  assert_eq(c->width(), 2 * w);
-  assert_eq(c->height(), 2 * h);
-  assert_eq(c->channels(), 3);
-  assert_eq(c->size(), 2 * w * 2 * h * 3);
-  delete c;
+  const Image c = image.crop_rect(0, 0, 2 * w, 2 * h);
+  assert_neq(c.data(), nullptr);
+  assert_eq(c.width(), 2 * w);
+  assert_eq(c.height(), 2 * h);
+  assert_eq(c.channels(), 3);
+  assert_eq(c.size(), 2 * w * 2 * h * 3);
 }
 
 void test_crop_2(void) {
@@ -117,13 +142,12 @@ void test_crop_2(void) {
 
   for (unsigned i = 0; i < n_images; i++) {
     futures[i] = pool.push([&image, w, h](int) {
-      const Image *c = image.crop_rect(-w, -h, 3 * w, 3 * h);
-      assert_neq(c, nullptr);
-      assert_eq(c->width(), 3 * w);
-      assert_eq(c->height(), 3 * h);
-      assert_eq(c->channels(), 3);
-      assert_eq(c->size(), 3 * w * 3 * h * 3);
-      delete c;
+      const Image c = image.crop_rect(-w, -h, 3 * w, 3 * h);
+      assert_neq(c.data(), nullptr);
+      assert_eq(c.width(), 3 * w);
+      assert_eq(c.height(), 3 * h);
+      assert_eq(c.channels(), 3);
+      assert_eq(c.size(), 3 * w * 3 * h * 3);
       return 0;
     });
   }
@@ -133,6 +157,812 @@ void test_crop_2(void) {
   }
 }
 
+void crop_test_3(void) {
+  static const int channels[] = {1, 2, 3, 4};
+  for (const int c : channels) {
+    Image image = Image(97, 53, c);
+    for (size_t k = 0; k < image.size(); k++) {
+      image.data()[k] = (unsigned char)(k * 7 + 3);
+    }
+    for (int k = 0; k < N; k++) {
+      const int x = k * 13 % 140 - 40, y = k * 29 % 90 - 30;
+      const int cw = 1 + k * 5 % 70, ch = 1 + k * 11 % 50;
+      const Image *c0 = crop_rect_ref(image, x, y, cw, ch);
+      const Image c1 = image.crop_rect(x, y, cw, ch);
+      assert_eq(c0->size(), c1.size());
+      assert_eq(memcmp(c0->data(), c1.data(), c0->size()), 0);
+      delete c0;
+    }
+  }
+}
+
+void crop_test_4(void) {
+  Image image = Image(64, 64, 1);
+  for (size_t k = 0; k < image.size(); k++) {
+    image.data()[k] = (unsigned char)(k % 64);
+  }
+  // the shape is larger than the generated image, only its center is kept
+  const Image c = image.crop_rect(0, 0, 64, 64, nullptr, 16, 8);
+  assert_eq(c.width(), 16);
+  assert_eq(c.height(), 8);
+  for (int j = 0; j < 16; j++) {
+    assert_eq(c.data()[j], 24 + j);
+  }
+}
+
+void crop_test_5(void) {
+  static const int channels[] = {1, 2, 3, 4};
+  for (const int c : channels) {
+    Image image = Image(97, 53, c);
+    for (size_t k = 0; k < image.size(); k++) {
+      image.data()[k] = (unsigned char)(k * 7 + 3);
+    }
+    for (int k = 0; k < 4 * N; k++) {
+      const int x = k * 13 % 140 - 40, y = k * 29 % 90 - 30;
+      const int cw = 1 + k * 5 % 70, ch = 1 + k * 11 % 50;
+      const Image *c0 = crop_ellipse_ref(image, x, y, cw, ch);
+      const Image c1 = image.crop_ellipse(x, y, cw, ch);
+      assert_eq(c0->size(), c1.size());
+      assert_eq(memcmp(c0->data(), c1.data(), c0->size()), 0);
+      delete c0;
+    }
+  }
+}
+
+void crop_test_6(void) {
+  Image image = Image(97, 53, 3);
+  Image bg = Image(41, 77, 3);
+  for (size_t k = 0; k < image.size(); k++) {
+    image.data()[k] = (unsigned char)(k * 7 + 3);
+  }
+  for (size_t k = 0; k < bg.size(); k++) {
+    bg.data()[k] = (unsigned char)(k * 5 + 1);
+  }
+  for (int k = 0; k < 4 * N; k++) {
+    const int x = k * 13 % 140 - 40, y = k * 29 % 90 - 30;
+    const int sw = 1 + k * 5 % 50, sh = 1 + k * 11 % 50;
+    const int cw = sw + k % 13, ch = sh + k % 7;
+
+    // the previous way: crop the background first, then copy over it
+    Image *d0 = crop_rect_ref(bg, bg.width() / 2 - cw / 2,
+                              bg.height() / 2 - ch / 2, cw, ch);
+    Image *d1 = crop_rect_ref(bg, bg.width() / 2 - cw / 2,
+                              bg.height() / 2 - ch / 2, cw, ch);
+    crop_rect_ref(image, x, y, sw, sh, d0, cw, ch);
+    crop_ellipse_ref(image, x, y, sw, sh, d1, cw, ch);
+
+    const Image c0 = image.crop_rect(x, y, sw, sh, &bg, cw, ch);
+    const Image c1 = image.crop_ellipse(x, y, sw, sh, &bg, cw, ch);
+    assert_eq(memcmp(c0.data(), d0->data(), d0->size()), 0);
+    assert_eq(memcmp(c1.data(), d1->data(), d1->size()), 0);
+    delete d0;
+    delete d1;
+  }
+}
+
+void mask_test_0(void) {
+  MaskCache &cache = MaskCache::instance();
+  const unsigned long misses = cache.misses();
+  const unsigned long hits = cache.hits();
+
+  const std::shared_ptr<const Spans> s0 = cache.ellipse(1021, 7);
+  const std::shared_ptr<const Spans> s1 = cache.ellipse(1021, 7);
+  assert_eq(s0.get(), s1.get());
+  assert_eq(s0->size(), 7);
+  assert_eq(cache.misses(), misses + 1);
+  assert_eq(cache.hits(), hits + 1);
+
+  // the spans match the per-pixel test
+  const float rx = 1021 / 2.0f, ry = 7 / 2.0f;
+  for (int i = 0; i < 7; i++) {
+    for (int j = 0; j < 1021; j++) {
+      const float dx = static_cast<float>(j) - rx;
+      const float dy = static_cast<float>(i) - ry;
+      const bool in = dx * dx / (rx * rx) + dy * dy / (ry * ry) <= 1;
+      assert_eq(in, (*s0)[i].first <= j && j < (*s0)[i].second);
+    }
+  }
+}
+
+void view_test_0(void) {
+  Image image = Image(97, 53, 3);
+  for (size_t k = 0; k < image.size(); k++) {
+    image.data()[k] = (unsigned char)(k * 7 + 3);
+  }
+  const Image c = image.crop_rect(11, 5, 40, 30);
+
+  // strided png, and bmp which needs contiguous rows
+  static const char *paths[] = {"view_test_0.png", "view_test_0.bmp"};
+  for (const char *path : paths) {
+    assert(image.view(11, 5, 40, 30).write(path));
+    const Image read = Image(path);
+    assert_eq(read.width(), 40);
+    assert_eq(read.height(), 30);
+    assert_eq(memcmp(read.data(), c.data(), c.size()), 0);
+    assert_eq(remove(path), 0);
+  }
+}
+
+void pool_test_0(void) {
+  // a new thread starts with an empty pool
+  std::thread([]() {
+    BufferPool &pool = BufferPool::local();
+    size_t c0 = 0, c1 = 0;
+    unsigned char *b0 = pool.acquire(1000, c0);
+    assert_eq(reinterpret_cast<uintptr_t>(b0) % 64, 0);
+    assert_geq(c0, 1000);
+    pool.release(b0, c0);
+
+    // the idle buffer is reused for a request that fits
+    unsigned char *b1 = pool.acquire(900, c1);
+    assert_eq(b0, b1);
+    assert_eq(c0, c1);
+    pool.release(b1, c1);
+  }).join();
+
+  BufferPool &pool = BufferPool::local();
+  size_t c1 = 0;
+
+  // pooled crops are fully written, even if the buffer was dirty
+  unsigned char *b2 = pool.acquire(64 * 64 * 3, c1);
+  memset(b2, 0xff, c1);
+  pool.release(b2, c1);
+  const Image image = Image(16, 16);
+  const Image c = image.crop_ellipse(-8, -8, 64, 64);
+  for (size_t k = 0; k < c.size(); k++) {
+    assert_eq(c.data()[k], 0);
+  }
+}
+
+void pool_test_1(void) {
+  static const int threads[] = {1, 3, 8};
+  for (const int n : threads) {
+    ThreadPool pool(n);
+    assert_eq(pool.size(), n);
+
+    // tasks queued from the outside, and from inside the tasks
+    std::atomic<int> nested(0);
+    std::vector<std::future<int>> futures;
+    for (int k = 0; k < 200; k++) {
+      futures.push_back(pool.push([&pool, &nested, k, n](int id) {
+        assert_lt(id, n);
+        if (k % 10 == 0) pool.push([&nested](int) { nested++; });
+        return k * k;
+      }));
+    }
+    for (int k = 0; k < 200; k++) {
+      assert_eq(futures[k].get(), k * k);
+    }
+    pool.stop(true);
+    assert_eq(nested.load(), 20);
+  }
+
+  // stopping without waiting drops the queued tasks
+  ThreadPool pool(1);
+  std::atomic<int> done(0);
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  pool.push([opened](int) { opened.wait(); });
+  for (int k = 0; k < 10; k++) {
+    pool.push([&done](int) { done++; });
+  }
+  std::thread opener([&gate]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate.set_value();
+  });
+  pool.stop(false);
+  opener.join();
+  assert_eq(done.load(), 0);
+}
+
+void pool_test_2(void) {
+  // inline tasks are moved along with their captures
+  std::shared_ptr<int> owned = std::make_shared<int>(7);
+  int seen = 0;
+  InlineTask a([owned, &seen](int id) { seen = *owned + id; });
+  assert_eq(owned.use_count(), 2);
+  InlineTask b(std::move(a));
+  assert(!a && b);
+  b(1);
+  assert_eq(seen, 8);
+  b.reset();
+  assert_eq(owned.use_count(), 1);
+
+  // posted tasks fill their own result, all of them ran once stopped
+  static const int threads[] = {1, 4};
+  for (const int n : threads) {
+    const unsigned tasks = 500;
+    std::vector<unsigned> results(tasks);
+    ThreadPool pool(n);
+    pool.reserve(tasks);
+    for (unsigned k = 0; k < tasks; k++) {
+      pool.post([&results, k](int) { results[k] = k * 3; });
+    }
+    pool.stop(true);
+    for (unsigned k = 0; k < tasks; k++) {
+      assert_eq(results[k], k * 3);
+    }
+  }
+}
+
+void probe_test_0(void) {
+  const Image image = Image(37, 21, 4);
+  assert(image.write("probe_test_0.png"));
+
+  int w = 0, h = 0, c = 0;
+  assert(Image::probe("probe_test_0.png", w, h, c));
+  assert_eq(w, 37);
+  assert_eq(h, 21);
+  assert_eq(c, 4);
+  assert_eq(remove("probe_test_0.png"), 0);
+
+  assert(!Image::probe("probe_test_0.png", w, h, c));
+}
+
+void probe_test_1(void) {
+  // the in-memory codecs match the file ones
+  Image image = Image(23, 17, 3);
+  for (size_t k = 0; k < image.size(); k++) {
+    image.data()[k] = static_cast<unsigned char>(k * 7);
+  }
+  const ImageView view = image.view(3, 2, 11, 9);
+  assert(view.write("probe_test_1.png"));
+
+  std::vector<unsigned char> file, bytes;
+  assert(read_file("probe_test_1.png", file));
+  assert(view.encode(ImageType::png, bytes));
+  assert(file == bytes);
+
+  int w = 0, h = 0, c = 0;
+  assert(Image::probe(bytes.data(), bytes.size(), w, h, c));
+  assert_eq(w, 11);
+  assert_eq(h, 9);
+  Image decoded;
+  assert(decoded.decode(bytes.data(), bytes.size()));
+  const Image read = Image("probe_test_1.png");
+  assert_eq(decoded.size(), read.size());
+  assert_eq(memcmp(decoded.data(), read.data(), read.size()), 0);
+  assert_eq(remove("probe_test_1.png"), 0);
+
+  assert(!read_file("probe_test_1.png", file));
+}
+
+void pipeline_test_0(void) {
+  // a full queue holds the producer back, a closed one stops it
+  BoundedQueue<int> queue(2);
+  unsigned long long waited = 0;
+  int item = 1;
+  assert(queue.push(std::move(item), waited));
+  item = 2;
+  assert(queue.push(std::move(item), waited));
+  std::thread consumer([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    unsigned long long w = 0;
+    int first = 0;
+    assert(queue.pop(first, w));
+    assert_eq(first, 1);
+  });
+  item = 3;
+  assert(queue.push(std::move(item), waited));
+  consumer.join();
+  assert_gt(waited, 0);
+  queue.close(true);
+  assert(!queue.push(std::move(item), waited));
+  assert(!queue.pop(item, waited));
+
+  // two stages, every item reaches the end once
+  static const int threads[] = {1, 3};
+  for (const int n : threads) {
+    ThreadPool pool(2 * n); // a thread for every worker
+    Stage twice("twice", n), sum("sum", n);
+    BoundedQueue<int> in(1000), out(4);
+    for (int k = 0; k < 1000; k++) {
+      int v = k;
+      in.push(std::move(v), waited);
+    }
+    in.close();
+
+    std::atomic<long> total(0);
+    twice.start(
+        pool, in,
+        [&](int &v, int id) {
+          assert_lt(id, n);
+          int w = 2 * v;
+          twice.emit(out, std::move(w));
+        },
+        [&out]() { out.close(); });
+    sum.start(
+        pool, out, [&total](int &v, int) { total += v; }, []() {});
+    twice.join();
+    sum.join();
+    assert_eq(total.load(), 999 * 1000);
+  }
+}
+
+void pipeline_test_1(void) {
+  // contiguous ranges of similar weight, none of them empty
+  const std::vector<double> even(8, 1.0);
+  assert(split_ranges(even, 4) == std::vector<size_t>({0, 2, 4, 6, 8}));
+  assert(split_ranges(even, 1) == std::vector<size_t>({0, 8}));
+  assert(split_ranges(even, 20).size() == 9);
+
+  const std::vector<double> skewed = {8, 1, 1, 1, 1, 0, 4};
+  const std::vector<size_t> bounds = split_ranges(skewed, 3);
+  assert(bounds == std::vector<size_t>({0, 1, 4, 7}));
+
+  assert(split_ranges(std::vector<double>(), 4) == std::vector<size_t>({0}));
+
+  // one batch per megapixel of composed crops, up to one per worker
+  const std::vector<double> small(4, 0.2 * batch_pixels);
+  assert(split_batches(small, 8) == std::vector<size_t>({0, 4}));
+  const std::vector<double> viewed(6, 0.0);
+  assert(split_batches(viewed, 8) == std::vector<size_t>({0, 6}));
+  const std::vector<double> large(8, batch_pixels);
+  assert(split_batches(large, 4) == std::vector<size_t>({0, 2, 4, 6, 8}));
+  assert(split_batches(large, 16).size() == 9);
+  assert(split_batches(large, 1) == std::vector<size_t>({0, 8}));
+  const std::vector<double> halves(6, 0.5 * batch_pixels);
+  assert(split_batches(halves, 8) == std::vector<size_t>({0, 2, 4, 6}));
+  std::vector<double> below(3, batch_pixels / 3);
+  below[2] -= 1;
+  assert(split_batches(below, 8) == std::vector<size_t>({0, 3}));
+}
+
+void pipeline_test_2(void) {
+  MemoryBudget budget(100);
+  unsigned long long waited = 0;
+  assert(!budget.acquire(60, waited));
+  assert_eq(waited, 0);
+
+  // a request that does not fit waits for a release, and a smaller one that
+  // fits goes past it
+  std::atomic<int> admitted(0), large(0), small(0);
+  std::thread waiter([&budget, &admitted, &large]() {
+    unsigned long long w = 0;
+    assert(!budget.acquire(60, w));
+    assert_gt(w, 0);
+    large = ++admitted;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  assert(!budget.acquire(30, waited));
+  assert_eq(waited, 0);
+  assert_eq(admitted.load(), 0);
+  budget.release(30);
+  budget.release(60);
+  waiter.join();
+  assert_eq(large.load(), 1);
+  assert_eq(budget.peak(), 90);
+
+  // once the oldest request was overtaken enough, the others wait behind it
+  MemoryBudget aged(100, 1);
+  assert(!aged.acquire(60, waited));
+  admitted = 0;
+  large = 0;
+  waiter = std::thread([&aged, &admitted, &large]() {
+    unsigned long long w = 0;
+    assert(!aged.acquire(60, w));
+    large = ++admitted;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  assert(!aged.acquire(30, waited)); // overtakes it once
+  aged.release(30);
+  std::thread behind([&aged, &admitted, &small]() {
+    unsigned long long w = 0;
+    assert(!aged.acquire(30, w));
+    assert_gt(w, 0);
+    small = ++admitted;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  assert_eq(admitted.load(), 0); // 30 would fit, but waits
+  aged.release(60);
+  waiter.join();
+  behind.join();
+  assert_eq(large.load(), 1);
+  assert_eq(small.load(), 2);
+
+  // larger than the whole budget, let through once nothing else is held
+  budget.release(60);
+  assert(budget.acquire(500, waited));
+  budget.release(500);
+}
+
+void label_test_0(void) {
+  // the fast path and sscanf agree on the result and every field
+  static const char *lines[] = {
+      "0 0.5 0.25 0.125 0.0625 0.9",
+      "  12\t0.1234567 -0.5 +.5 5. 1e-3  ",
+      "3 0.123456789012345678901 1E+2 7e22 1e23 0.3\r",
+      "4 inf nan 0x1p-2 1e 0.5",
+      "5 0.5 0.5",
+      "1.0 0.5 0.5 0.5 0.5",
+      "abc 0.5",
+      "7 - 0.5",
+      "8 0.5,0.5",
+      "   ",
+      "",
+      "\r",
+  };
+  for (const char *line : lines) {
+    Box ref, cur;
+    memset(&ref, 0x5a, sizeof(Box));
+    memset(&cur, 0x5a, sizeof(Box));
+    const int err = sscanf(line, "%d %lf %lf %lf %lf %lf", &ref.cls, &ref.cx,
+                           &ref.cy, &ref.w, &ref.h, &ref.score);
+    assert_eq(parse_box(line, line + strlen(line), cur), err);
+    assert_eq(memcmp(&ref, &cur, sizeof(Box)), 0);
+  }
+
+  // lines are split like std::getline, and a blank line stops the parse
+  FILE *f = fopen("label_test_0.txt", "w");
+  fputs("1 0.5 0.5 0.25 0.25 0.75\n2 0.1 0.2 0.3 0.4\n\n3 0 0 0 0 1", f);
+  fclose(f);
+
+  std::vector<Box> boxes;
+  assert(read_labels("label_test_0.txt", boxes) == LabelStatus::malformed);
+  assert_eq(boxes.size(), 2);
+  assert_eq(boxes[1].cls, 2);
+  assert_eq(boxes[1].score, 0.75); // kept from the previous line
+  assert_eq(remove("label_test_0.txt"), 0);
+
+  assert(read_labels("label_test_0.txt", boxes) == LabelStatus::unreadable);
+}
+
+void label_test_1(void) {
+  FILE *f = fopen("label_test_1.csv", "w");
+  fputs("image,class,x,y,w,h,confidence\n"
+        "frames/a.png,1,0.5,0.5,0.25,0.25,0.75\r\n"
+        "a\t2\t0.1\t0.2\t0.3\t0.4\n"
+        "\n"
+        "b.jpg,3,0,0,1,1\n",
+        f);
+  fclose(f);
+
+  const LabelIndex index = LabelIndex("label_test_1.csv");
+  assert_eq(index.images(), 2);
+  assert_eq(index.rows(), 3);
+
+  std::vector<Box> boxes;
+  assert(index.read("a", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 2);
+  assert_eq(boxes[0].cls, 1);
+  assert_eq(boxes[0].score, 0.75);
+  assert_eq(boxes[1].cls, 2);
+  assert_eq(boxes[1].h, 0.4);
+
+  boxes.clear();
+  assert(index.read("b", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 1);
+  assert_eq(boxes[0].score, 1.0); // no confidence column
+
+  boxes.clear();
+  assert(index.read("c", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 0);
+
+  // the header comes after blank rows and comments
+  f = fopen("label_test_1.csv", "w");
+  fputs("\n  \r\n# exported labels\nimage\tclass\tx\ty\tw\th\n"
+        "a\t2\t0.1\t0.2\t0.3\t0.4\n  a.png \t3\t0.1\t0.2\t0.3\t0.4\n",
+        f);
+  fclose(f);
+  const LabelIndex late = LabelIndex("label_test_1.csv");
+  assert_eq(late.rows(), 2);
+  assert_eq(late.images(), 1); // the blanks around the names are trimmed
+
+  // a confidence that is not a number is a malformed row, like a header
+  // anywhere else than first
+  static const char *malformed[] = {
+      "image,class,x,y,w,h,confidence\na,1,0.5,0.5,0.25,0.25,high\n",
+      "a,1,0.5,0.5,0.25,0.25\nimage,class,x,y,w,h\n",
+  };
+  for (const char *rows : malformed) {
+    f = fopen("label_test_1.csv", "w");
+    fputs(rows, f);
+    fclose(f);
+    bool thrown = false;
+    try {
+      LabelIndex("label_test_1.csv");
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  assert_eq(remove("label_test_1.csv"), 0);
+}
+
+void label_test_2(void) {
+  assert_eq(mkdir("label_test_2", 0755), 0);
+  FILE *f = fopen("label_test_2/a.txt", "w");
+  fputs("1 0.5 0.5 0.25 0.25 0.75\n2 0.1 0.2 0.3 0.4 0.5\n", f);
+  fclose(f);
+  f = fopen("label_test_2/b.txt", "w");
+  fputs("3 0.5 0.5 0.5 0.5 0.5\n\n", f);
+  fclose(f);
+
+  const std::vector<std::string> stems = {"a", "b", "c"};
+  const LabelFolder folder = LabelFolder("label_test_2/");
+  auto same = [&](const LabelCache &cache) {
+    for (const std::string &stem : stems) {
+      std::vector<Box> b0, b1;
+      assert(cache.read(stem, b0) == folder.read(stem, b1));
+      assert_eq(b0.size(), b1.size());
+      for (size_t k = 0; k < b0.size(); k++) {
+        assert_eq(b0[k].cls, b1[k].cls);
+        assert_eq(b0[k].cx, b1[k].cx);
+        assert_eq(b0[k].score, b1[k].score);
+      }
+    }
+  };
+
+  const LabelCache c0("label_test_2.bin", folder, stems);
+  assert(c0.compiled());
+  same(c0);
+  const LabelCache c1("label_test_2.bin", folder, stems);
+  assert(!c1.compiled());
+  same(c1);
+
+  // a config file that changes, or a new image, invalidate the cache
+  f = fopen("label_test_2/a.txt", "a");
+  fputs("4 0.5 0.5 0.5 0.5 0.5\n", f);
+  fclose(f);
+  const LabelCache c2("label_test_2.bin", folder, stems);
+  assert(c2.compiled());
+  same(c2);
+  const std::vector<std::string> more = {"a", "b", "c", "d"};
+  assert(LabelCache("label_test_2.bin", folder, more).compiled());
+
+  // an entry whose name offset wraps around past the names is corrupted, the
+  // cache is compiled again (the entries follow the 40 byte header and the
+  // signature, the name offset is at byte 40 of an entry)
+  f = fopen("label_test_2.bin", "r+b");
+  uint32_t source_length = 0;
+  assert_eq(fseek(f, 12, SEEK_SET), 0);
+  assert_eq(fread(&source_length, sizeof(uint32_t), 1, f), 1);
+  const uint32_t wrapped = 0xffffffff;
+  assert_eq(fseek(f, (40 + source_length + 7) / 8 * 8 + 40, SEEK_SET), 0);
+  assert_eq(fwrite(&wrapped, sizeof(uint32_t), 1, f), 1);
+  fclose(f);
+  const LabelCache c3("label_test_2.bin", folder, more);
+  assert(c3.compiled());
+  same(c3);
+
+  assert_eq(remove("label_test_2/a.txt"), 0);
+  assert_eq(remove("label_test_2/b.txt"), 0);
+  assert_eq(remove("label_test_2"), 0);
+  assert_eq(remove("label_test_2.bin"), 0);
+}
+
+void coco_test_0(void) {
+  FILE *f = fopen("coco_test_0.json", "w");
+  fputs("{\"info\": {\"description\": \"a \\\"test\\\" [{\"},\n"
+        " \"annotations\": [\n"
+        "  {\"id\": 1, \"image_id\": 7, \"category_id\": 3,\n"
+        "   \"segmentation\": [[1, 2, 3, 4]], \"iscrowd\": false,\n"
+        "   \"bbox\": [10, 20, 30, 40.5]},\n"
+        "  {\"image_id\": 8, \"category_id\": 1, \"bbox\": [0, 0, 200, 100],"
+        "   \"score\": 0.25},\n"
+        "  {\"image_id\": 9, \"category_id\": 1, \"bbox\": [0, 0, 1, 1]}],\n"
+        " \"images\": [{\"id\": 7, \"file_name\": \"dir/caf\\u00e9.jpg\",\n"
+        "   \"width\": 100, \"height\": 200, \"license\": null},\n"
+        "  {\"file_name\": \"b.png\", \"height\": 100, \"width\": 200,"
+        "   \"id\": 8}],\n"
+        " \"categories\": [{\"id\": 1, \"name\": \"x\"}]}\n",
+        f);
+  fclose(f);
+
+  const CocoIndex coco = CocoIndex("coco_test_0.json");
+  assert_eq(coco.images(), 2);
+  assert_eq(coco.rows(), 2);
+  assert_eq(coco.orphans(), 1);
+
+  std::vector<Box> boxes;
+  assert(coco.read("caf\xc3\xa9", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 1);
+  assert_eq(boxes[0].cls, 3);
+  assert_eq(boxes[0].cx, 0.25);
+  assert_eq(boxes[0].cy, (20 + 40.5 / 2) / 200);
+  assert_eq(boxes[0].h, 40.5 / 200);
+  assert_eq(boxes[0].score, 1.0);
+
+  boxes.clear();
+  assert(coco.read("b", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 1);
+  assert_eq(boxes[0].w, 1.0);
+  assert_eq(boxes[0].score, 0.25);
+
+  // the images before the annotations, which go straight to the table
+  f = fopen("coco_test_0.json", "w");
+  fputs("{\"images\": [{\"id\": 1, \"file_name\": \"a.png\", \"width\": 10,"
+        " \"height\": 20}, {\"id\": 2, \"file_name\": \"b.png\"}],\n"
+        " \"annotations\": [{\"image_id\": 1, \"bbox\": [0, 0, 5, 5]},\n"
+        "  {\"image_id\": 2, \"bbox\": [0, 0, 5, 5]},\n"
+        "  {\"image_id\": 1, \"category_id\": 4, \"bbox\": [5, 10, 5, 10]}]}",
+        f);
+  fclose(f);
+  const CocoIndex ordered = CocoIndex("coco_test_0.json");
+  assert_eq(ordered.images(), 1);
+  assert_eq(ordered.rows(), 2);
+  assert_eq(ordered.orphans(), 1);
+  boxes.clear();
+  assert(ordered.read("a", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 2);
+  assert_eq(boxes[0].cx, 0.25);
+  assert_eq(boxes[1].cls, 4);
+  assert_eq(boxes[1].cy, 0.75);
+
+  // a number too long to be converted is an error, not a truncated value,
+  // and so are bytes beyond ASCII out of the strings
+  static const char *malformed[] = {
+      "{\"images\": [{\"id\": 1, \"width\": "
+      "100000000000000000000000000000000000000000000000000000000000000000}]}",
+      "{\"images\": [{\"id\": 1\xc3\xa9}]}",
+      "{\"info\": nul\xc3\xa9, \"images\": []}",
+  };
+  for (const char *json : malformed) {
+    f = fopen("coco_test_0.json", "w");
+    fputs(json, f);
+    fclose(f);
+    bool thrown = false;
+    try {
+      CocoIndex("coco_test_0.json");
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  assert_eq(remove("coco_test_0.json"), 0);
+}
+
+void voc_test_0(void) {
+  assert_eq(mkdir("voc_test_0", 0755), 0);
+  FILE *f = fopen("voc_test_0/names.txt", "w");
+  fputs("cat\r\ndog\nperson\nR&D\n", f);
+  fclose(f);
+  f = fopen("voc_test_0/a.xml", "w");
+  fputs("<?xml version=\"1.0\"?>\n<!-- a comment <object> -->\n"
+        "<annotation verified=\"no > yes\">\n"
+        "  <size><width>200</width><height>100</height><depth>3</depth>"
+        "</size>\n  <segmented/>\n"
+        "  <object><name> dog </name><difficult>0</difficult>\n"
+        "    <bndbox><xmin>11</xmin><ymin>21</ymin><xmax>51</xmax>"
+        "<ymax>61</ymax></bndbox></object>\n"
+        "  <object><name>person</name><bndbox><xmin>1</xmin><ymin>1</ymin>"
+        "<xmax>101</xmax><ymax>91</ymax></bndbox>\n"
+        "    <part><name>head</name><bndbox><xmin>2</xmin><ymin>2</ymin>"
+        "<xmax>3</xmax><ymax>3</ymax></bndbox></part></object>\n"
+        "  <object><name>cat</name><difficult>1</difficult><bndbox>"
+        "<xmin>1</xmin><ymin>1</ymin><xmax>2</xmax><ymax>2</ymax></bndbox>"
+        "</object>\n"
+        "  <object><name>bird</name><bndbox><xmin>1</xmin><ymin>1</ymin>"
+        "<xmax>2</xmax><ymax>2</ymax></bndbox></object>\n"
+        "  <object><name>R&amp;D</name><bndbox><xmin>1</xmin><ymin>1</ymin>"
+        "<xmax>21</xmax><ymax>11</ymax></bndbox></object>\n"
+        "</annotation>\n",
+        f);
+  fclose(f);
+  f = fopen("voc_test_0/b.xml", "w");
+  fputs("<annotation><size><width>10</width></size></annotation>", f);
+  fclose(f);
+
+  const VocFolder voc("voc_test_0/", "voc_test_0/names.txt");
+  std::vector<Box> boxes;
+  assert(voc.read("a", boxes) == LabelStatus::ok);
+  assert_eq(boxes.size(), 3); // without the difficult and unknown objects
+  assert_eq(boxes[0].cls, 1);
+  assert_eq(boxes[0].cx, 0.15);
+  assert_eq(boxes[0].cy, 0.4);
+  assert_eq(boxes[0].w, 0.2);
+  assert_eq(boxes[0].h, 0.4);
+  assert_eq(boxes[1].cls, 2);
+  assert_eq(boxes[1].w, 0.5);
+  assert_eq(boxes[2].cls, 3); // R&amp;D
+  assert_eq(voc.dropped(), 1);
+  assert(voc.read("b", boxes) == LabelStatus::malformed);
+  assert(voc.read("c", boxes) == LabelStatus::unreadable);
+
+  // the cache serves the same objects, and counts the same unknown ones
+  const std::vector<std::string> stems = {"a", "b", "c"};
+  const LabelCache compiled("voc_test_0.bin", voc, stems);
+  assert(compiled.compiled());
+  assert_eq(compiled.dropped(), 0);
+  const LabelCache cache("voc_test_0.bin", voc, stems);
+  assert(!cache.compiled());
+  std::vector<Box> cached;
+  assert(cache.read("a", cached) == LabelStatus::ok);
+  assert_eq(cached.size(), 3);
+  assert_eq(cached[1].cx, boxes[1].cx);
+  assert_eq(cache.dropped(), 1);
+  assert(cache.read("b", cached) == LabelStatus::malformed);
+  assert(cache.read("a", cached) == LabelStatus::ok);
+  assert_eq(cache.dropped(), 2);
+  assert_eq(voc.dropped(), 2); // the files were read once more to compile
+
+  assert_eq(remove("voc_test_0/names.txt"), 0);
+  assert_eq(remove("voc_test_0/a.xml"), 0);
+  assert_eq(remove("voc_test_0/b.xml"), 0);
+  assert_eq(remove("voc_test_0"), 0);
+  assert_eq(remove("voc_test_0.bin"), 0);
+}
+
+void nms_test_0(void) {
+  // clusters of boxes of a few classes, some of them degenerate
+  std::vector<Box> boxes;
+  unsigned seed = 7;
+  auto next = [&]() {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) / static_cast<double>(1 << 24);
+  };
+  for (int k = 0; k < 3000; k++) {
+    Box b;
+    b.cls = k % 3;
+    b.cx = (k % 40) / 40.0 + next() * 0.02;
+    b.cy = (k % 17) / 17.0 + next() * 0.02;
+    b.w = k % 97 == 0 ? 0 : 0.01 + next() * 0.1;
+    b.h = 0.01 + next() * 0.1;
+    b.score = k % 5 == 0 ? 0.5 : next();
+    boxes.push_back(b);
+  }
+
+  static const double ious[] = {0, 0.3, 0.5, 0.9, 1};
+  for (const double iou : ious) {
+    std::vector<Box> b0 = boxes, b1 = boxes;
+    assert_eq(suppress_overlaps(b0, iou), suppress_overlaps_ref(b1, iou));
+    assert_eq(b0.size(), b1.size());
+    assert_eq(memcmp(b0.data(), b1.data(), b0.size() * sizeof(Box)), 0);
+  }
+
+  // a duplicate is suppressed, another class is not
+  std::vector<Box> pair = {{0, 0.5, 0.5, 0.2, 0.2, 0.6},
+                           {0, 0.51, 0.5, 0.2, 0.2, 0.9},
+                           {1, 0.5, 0.5, 0.2, 0.2, 0.1}};
+  assert_eq(suppress_overlaps(pair, 0.5), 1);
+  assert_eq(pair.size(), 2);
+  assert_eq(pair[0].score, 0.9);
+  assert_eq(pair[1].cls, 1);
+}
+
+/// @brief `n` images of `objects` objects each, with their config files
+static void make_dataset(const std::string &dir, const int n,
+                         const int objects) {
+  assert_eq(mkdir(dir.c_str(), 0755), 0);
+  for (int k = 0; k < n; k++) {
+    const std::string name = dir + "/img" + std::to_string(k);
+    const Image image = Image(40 + k % 7 * 30, 48, 3);
+    assert(image.write(name + ".png"));
+
+    FILE *f = fopen((name + ".txt").c_str(), "w");
+    for (int o = 0; o < objects; o++) {
+      // a few classes and sizes, all inside of the image
+      fprintf(f, "%d 0.5 0.5 %.3f %.3f 0.9\n", (k + o) % 3,
+              0.2 + 0.1 * (o % 4), 0.3 + 0.05 * (k % 5));
+    }
+    fclose(f);
+  }
+}
+
+/// @brief remove a folder and the files it holds
+static void remove_folder(const std::string &dir) {
+  std::vector<std::string> files;
+  get_files_in_folder(dir, files);
+  for (const std::string &file : files) {
+    assert_eq(remove((dir + '/' + file).c_str()), 0);
+  }
+  assert_eq(remove(dir.c_str()), 0);
+}
+
+/// @brief run the app with the given options, from a fresh output folder
+static RunReport run_app(const std::vector<std::string> &args) {
+  std::vector<char *> argv;
+  argv.push_back((char *)"app");
+  for (const std::string &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  App app = App(static_cast<int>(argv.size()) - 1, argv.data());
+  app.check_args();
+  assert_eq(app.run(), EXIT_SUCCESS);
+  return app.report();
+}
+
 void app_test_0(void) {
   char *argv[] = {(char *)"app",  (char *)"-i",     (char *)"../in",
                   (char *)"-o",   (char *)"../out", (char *)"-e",
@@ -169,6 +999,172 @@ void app_test_2(void) {
   assert_eq(files.size(), 2);
 }
 
+void app_test_3(void) {
+  // --trgt stops at the exact number of images, and the images left are
+  // accounted for
+  make_dataset("app_test_3", 30, 2);
+  static const char *stages[] = {"1,1,1,1,1", "2,3,2,3,2"};
+  for (const char *s : stages) {
+    static const int targets[] = {1, 5, 17};
+    for (const int trgt : targets) {
+      const RunReport r =
+          run_app({"-i", "app_test_3", "-o", "app_test_3_out", "--stages", s,
+                   "--trgt", std::to_string(trgt)});
+      assert_eq(r.images, 30);
+      assert_eq(r.created, trgt);
+      assert_eq(count_files_in_folder("app_test_3_out"), trgt);
+      assert_gt(r.unprocessed, 0);
+      assert_eq(r.processed + r.unprocessed, 30);
+      remove_folder("app_test_3_out");
+    }
+
+    // a target of 0 stands for all the crops of a single image
+    RunReport r = run_app({"-i", "app_test_3", "-o", "app_test_3_out",
+                           "--stages", s, "--trgt", "0"});
+    assert_eq(r.created, 2);
+    assert_eq(count_files_in_folder("app_test_3_out"), 2);
+    assert_eq(r.processed + r.unprocessed, 30);
+    remove_folder("app_test_3_out");
+
+    // a target out of reach creates every crop
+    r = run_app({"-i", "app_test_3", "-o", "app_test_3_out", "--stages", s,
+                 "--trgt", "100"});
+    assert_eq(r.created, 60);
+    assert_eq(count_files_in_folder("app_test_3_out"), 60);
+    assert_eq(r.processed, 30);
+    assert_eq(r.unprocessed, 0);
+    remove_folder("app_test_3_out");
+  }
+  remove_folder("app_test_3");
+}
+
+void app_test_4(void) {
+  // a slow image does not hold the others back, and every image is counted
+  // once whatever the order they complete in: the labels of the first image
+  // are a named pipe, its reader waits until the other images are written
+  make_dataset("app_test_4", 20, 2);
+  std::vector<std::string> files;
+  get_files_in_folder("app_test_4", files, ".png");
+  const std::string labels =
+      "app_test_4/" + files[0].substr(0, files[0].find_last_of('.')) + ".txt";
+  assert_eq(remove(labels.c_str()), 0);
+  assert_eq(mkfifo(labels.c_str(), 0644), 0);
+  std::vector<std::string> listed; // in the order the app lists them
+  get_files_in_folder("app_test_4", listed, ".png");
+  const unsigned held =
+      std::find(listed.begin(), listed.end(), files[0]) - listed.begin();
+
+  std::thread feeder([&labels]() {
+    // the crops of the other images, the last one may still be written
+    for (int k = 0; k < 6000 && count_files_in_folder("app_test_4_out") < 38;
+         k++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const int fd = open(labels.c_str(), O_WRONLY);
+    assert_neq(fd, -1);
+    close(fd); // no objects
+  });
+  const RunReport r = run_app({"-i", "app_test_4", "-o", "app_test_4_out",
+                               "--stages", "2,1,1,1,1"});
+  feeder.join();
+
+  assert_eq(r.order.size(), 20);
+  const size_t position = std::find(r.order.begin(), r.order.end(), held) -
+                          r.order.begin();
+  assert_geq(position, 18); // after the images whose crops were all written
+  std::vector<unsigned> sorted = r.order;
+  std::sort(sorted.begin(), sorted.end());
+  for (unsigned k = 0; k < 20; k++) {
+    assert_eq(sorted[k], k);
+  }
+  assert_eq(r.processed, 20);
+  assert_eq(r.created, 38);
+  assert_eq(count_files_in_folder("app_test_4_out"), 38);
+
+  remove_folder("app_test_4_out");
+  assert_eq(remove(labels.c_str()), 0);
+  remove_folder("app_test_4");
+}
+
+void app_test_5(void) {
+  // a dry run counts the crops that a real run creates, by class and size
+  make_dataset("app_test_5", 12, 5);
+  const std::vector<std::string> options = {"-i", "app_test_5", "-s", "20"};
+  std::vector<std::string> args = options;
+  args.push_back("--dry-run");
+  const RunReport dry = run_app(args);
+  args = options;
+  args.insert(args.end(), {"-o", "app_test_5_out"});
+  const RunReport real = run_app(args);
+
+  const crop_summary &s = dry.summary;
+  assert_eq(s.objects, 60);
+  assert_eq(s.kept, 60);
+  assert_gt(s.crops, 0);
+  assert_lt(s.crops, 60); // some objects are smaller than -s
+  assert_eq(dry.created, s.crops);
+  assert_eq(real.created, s.crops);
+
+  std::vector<std::string> files;
+  get_files_in_folder("app_test_5_out", files);
+  assert_eq(files.size(), s.crops);
+
+  // the class and the size of every crop, from the created images
+  std::map<int, unsigned long> classes;
+  unsigned long sizes[crop_summary::buckets] = {};
+  unsigned long long bytes = 0;
+  std::map<std::string, unsigned> images; // crops of each source image
+  for (const std::string &file : files) {
+    const size_t first = file.find('_');
+    images[file.substr(0, first)]++;
+    classes[std::stoi(file.substr(first + 1))]++;
+    int w = 0, h = 0, c = 0;
+    assert(Image::probe("app_test_5_out/" + file, w, h, c));
+    sizes[crop_summary::bucket(std::max(w, h))]++;
+    bytes += static_cast<unsigned long long>(w) * h * c;
+  }
+  assert(classes == s.classes);
+  assert_eq(memcmp(sizes, s.crop_sizes, sizeof(sizes)), 0);
+  assert_eq(bytes, s.bytes);
+  assert_eq(images.size(), s.images);
+
+  unsigned long objects = 0;
+  for (int b = 0; b < crop_summary::buckets; b++) {
+    objects += s.object_sizes[b];
+  }
+  assert_eq(objects, s.kept);
+
+  remove_folder("app_test_5_out");
+  remove_folder("app_test_5");
+}
+
+void app_test_6(void) {
+  // a dry run prepares the images on all the threads: while one worker is
+  // held by the labels of the first image, the others take the rest
+  make_dataset("app_test_6", 32, 2);
+  std::vector<std::string> files;
+  get_files_in_folder("app_test_6", files, ".png");
+  const std::string stem = files[0].substr(0, files[0].find_last_of('.'));
+  FILE *f = fopen(("app_test_6/" + stem + ".txt").c_str(), "w");
+  for (int o = 0; o < 100000; o++) {
+    fputs("1 0.5 0.5 0.25 0.25 0.9\n", f);
+  }
+  fclose(f);
+
+  const RunReport r = run_app({"-i", "app_test_6", "-t", "4", "--dry-run"});
+  assert_eq(r.prepared.size(), 4);
+  unsigned prepared = 0, workers = 0;
+  for (const unsigned p : r.prepared) {
+    prepared += p;
+    workers += p > 0;
+  }
+  assert_eq(prepared, 32);
+  assert_gt(workers, 1);
+  assert_eq(r.summary.objects, 100000 + 31 * 2);
+
+  remove_folder("app_test_6");
+}
+
 int main(void) {
   test_case(dummy_test);
 
@@ -176,14 +1172,40 @@ int main(void) {
   test_case(memory_test_1);
   test_case(memory_test_2);
   test_case(memory_test_3);
+  test_case(memory_test_4);
 
   test_case(crop_test_0);
   test_case(crop_test_1);
   test_case(test_crop_2);
+  test_case(crop_test_3);
+  test_case(crop_test_4);
+  test_case(crop_test_5);
+  test_case(crop_test_6);
+  test_case(mask_test_0);
+  test_case(view_test_0);
+  test_case(pool_test_0);
+  test_case(pool_test_1);
+  test_case(pool_test_2);
+  test_case(pipeline_test_0);
+  test_case(pipeline_test_1);
+  test_case(pipeline_test_2);
+
+  test_case(probe_test_0);
+  test_case(probe_test_1);
+  test_case(label_test_0);
+  test_case(label_test_1);
+  test_case(label_test_2);
+  test_case(coco_test_0);
+  test_case(voc_test_0);
+  test_case(nms_test_0);
 
   test_case(app_test_0);
   test_case(app_test_1);
   test_case(app_test_2);
+  test_case(app_test_3);
+  test_case(app_test_4);
+  test_case(app_test_5);
+  test_case(app_test_6);
 
   return EXIT_SUCCESS;
 }